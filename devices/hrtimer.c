@@ -0,0 +1,165 @@
+#include "devices/hrtimer.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <list.h>
+#include <stdio.h>
+#include "devices/lapic.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+/* High-resolution sleep.
+
+   The periodic timer only wakes sleepers on tick boundaries, so
+   sleeps shorter than a tick used to busy-wait.  Instead, a
+   sleeping thread now blocks until the TSC reaches its deadline,
+   and the local APIC timer is armed for the earliest deadline
+   pending.  Sleeps so short that blocking would cost more than
+   it saves spin on the TSC.  Without a local APIC,
+   hrtimer_available() returns false and callers must busy-wait
+   as before. */
+
+#define NSEC_PER_SEC 1000000000LL
+
+/* Sleeps shorter than this, in ns, spin on the TSC. */
+#define SPIN_NS 10000
+
+/* Ticks over which the TSC frequency is measured. */
+#define CALIB_TICKS 2
+
+/* A thread blocked in hrtimer_nsleep(). */
+struct sleeper {
+	struct list_elem elem;      /* Element in `sleepers'. */
+	uint64_t deadline;          /* TSC value to wake at. */
+	struct thread *thread;      /* Sleeping thread. */
+};
+
+/* Sleepers, by deadline.  Protected by disabling interrupts. */
+static struct list sleepers;
+
+/* TSC frequency in Hz, or 0 if the timer is unavailable. */
+static uint64_t tsc_hz;
+
+/* Statistics. */
+static uint64_t block_cnt;      /* # of sleeps that blocked. */
+static uint64_t spin_cnt;       /* # of sleeps that spun. */
+static uint64_t late_cycles;    /* Total TSC cycles woken late. */
+
+static intr_handler_func hrtimer_interrupt;
+static bool deadline_less (const struct list_elem *,
+		const struct list_elem *, void *aux);
+
+/* Measures the TSC frequency and sets up the local APIC timer.
+   Must be called after timer_calibrate(), with interrupts on. */
+void
+hrtimer_init (void) {
+	uint64_t tsc;
+	int64_t start;
+
+	list_init (&sleepers);
+	if (!lapic_init ()) {
+		printf ("hrtimer: no local APIC, sub-tick sleeps busy-wait.\n");
+		return;
+	}
+
+	start = timer_ticks ();
+	while (timer_ticks () == start)
+		continue;
+	tsc = rdtsc ();
+	while (timer_ticks () < start + 1 + CALIB_TICKS)
+		continue;
+	tsc = rdtsc () - tsc;
+
+	intr_register_ext (LAPIC_TIMER_VEC, hrtimer_interrupt, "LAPIC Timer");
+	if (!lapic_timer_init ()) {
+		printf ("hrtimer: local APIC timer did not count.\n");
+		return;
+	}
+	tsc_hz = tsc * TIMER_FREQ / CALIB_TICKS;
+	printf ("hrtimer: %"PRIu64" MHz TSC, local APIC timer in %s mode.\n",
+			tsc_hz / 1000000, lapic_tsc_deadline () ? "TSC-deadline" : "one-shot");
+}
+
+/* Returns true if hrtimer_nsleep() is usable. */
+bool
+hrtimer_available (void) {
+	return tsc_hz != 0;
+}
+
+/* Suspends execution for NS nanoseconds.  Blocks the thread
+   unless NS is very short.  Interrupts must be on. */
+void
+hrtimer_nsleep (int64_t ns) {
+	struct sleeper s;
+	enum intr_level old_level;
+	uint64_t start = rdtsc ();
+
+	ASSERT (hrtimer_available ());
+	ASSERT (intr_get_level () == INTR_ON);
+
+	if (ns <= 0)
+		return;
+	s.deadline = start + ns / NSEC_PER_SEC * tsc_hz
+		+ ns % NSEC_PER_SEC * tsc_hz / NSEC_PER_SEC;
+
+	if (ns < SPIN_NS) {
+		spin_cnt++;
+		while (rdtsc () < s.deadline)
+			barrier ();
+		return;
+	}
+
+	old_level = intr_disable ();
+	block_cnt++;
+	s.thread = thread_current ();
+	list_insert_ordered (&sleepers, &s.elem, deadline_less, NULL);
+	if (list_front (&sleepers) == &s.elem)
+		lapic_timer_arm (s.deadline);
+	thread_block ();
+	intr_set_level (old_level);
+}
+
+/* Prints high-resolution timer statistics. */
+void
+hrtimer_print_stats (void) {
+	if (!hrtimer_available ())
+		return;
+	printf ("hrtimer: %"PRIu64" sleeps blocked, %"PRIu64" spun, "
+			"%"PRIu64" ns mean lateness\n", block_cnt, spin_cnt,
+			block_cnt != 0
+				? late_cycles / block_cnt * 1000000 / (tsc_hz / 1000) : 0);
+}
+
+/* Local APIC timer interrupt handler.  Wakes the sleepers that
+   are due and re-arms the timer for the next one, if any. */
+static void
+hrtimer_interrupt (struct intr_frame *args UNUSED) {
+	uint64_t now = rdtsc ();
+
+	while (!list_empty (&sleepers)) {
+		struct sleeper *s = list_entry (list_front (&sleepers),
+				struct sleeper, elem);
+		if (s->deadline > now)
+			break;
+		list_pop_front (&sleepers);
+		late_cycles += now - s->deadline;
+		thread_unblock (s->thread);
+		if (thread_outranks (s->thread, thread_current ()))
+			intr_yield_on_return ();
+	}
+	if (!list_empty (&sleepers))
+		lapic_timer_arm (list_entry (list_front (&sleepers),
+					struct sleeper, elem)->deadline);
+}
+
+/* Returns true if sleeper A's deadline precedes B's. */
+static bool
+deadline_less (const struct list_elem *a_, const struct list_elem *b_,
+		void *aux UNUSED) {
+	const struct sleeper *a = list_entry (a_, struct sleeper, elem);
+	const struct sleeper *b = list_entry (b_, struct sleeper, elem);
+
+	return a->deadline < b->deadline;
+}
@@ -0,0 +1,195 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include "devices/timer.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Local APIC of the bootstrap processor.  See [IA32-v3a] chapter
+   10 "Advanced Programmable Interrupt Controller (APIC)".
+
+   The 8259A PICs stay in charge of the device interrupts: the
+   local APIC is put in virtual wire mode, which passes them
+   through LINT0 unchanged, and only its timer is used. */
+
+/* CPUID leaf 1 feature bits. */
+#define CPUID_1_EDX_APIC (1u << 9)      /* Local APIC present. */
+#define CPUID_1_ECX_TSC_DL (1u << 24)   /* TSC-deadline timer mode. */
+
+/* Model-specific registers. */
+#define MSR_APIC_BASE 0x1b              /* Local APIC base address. */
+#define MSR_TSC_DEADLINE 0x6e0          /* TSC-deadline timer target. */
+#define APIC_BASE_ENABLE (1u << 11)     /* Global enable. */
+#define APIC_BASE_ADDR 0x000ffffffffff000ULL
+
+/* Memory-mapped registers, by byte offset. */
+#define LAPIC_ID 0x020                  /* Local APIC ID. */
+#define LAPIC_EOI 0x0b0                 /* End of interrupt. */
+#define LAPIC_SVR 0x0f0                 /* Spurious interrupt vector. */
+#define LAPIC_LVT_TIMER 0x320           /* Timer local vector. */
+#define LAPIC_LVT_LINT0 0x350           /* LINT0 local vector. */
+#define LAPIC_LVT_LINT1 0x360           /* LINT1 local vector. */
+#define LAPIC_TIMER_ICR 0x380           /* Timer initial count. */
+#define LAPIC_TIMER_CCR 0x390           /* Timer current count. */
+#define LAPIC_TIMER_DCR 0x3e0           /* Timer divide configuration. */
+
+#define SVR_ENABLE (1u << 8)            /* Software enable. */
+#define LVT_MASKED (1u << 16)           /* Interrupt masked. */
+#define LVT_EXTINT (7u << 8)            /* Delivery mode ExtINT. */
+#define LVT_NMI (4u << 8)               /* Delivery mode NMI. */
+#define LVT_TIMER_ONESHOT (0u << 17)    /* Timer mode one-shot. */
+#define LVT_TIMER_TSC_DL (2u << 17)     /* Timer mode TSC-deadline. */
+#define DCR_DIV1 0xb                    /* Count at the bus clock. */
+
+/* Ticks over which the one-shot timer is calibrated. */
+#define CALIB_TICKS 2
+
+/* Farthest a one-shot is armed ahead, in TSC cycles, so that the
+   count conversion cannot overflow. */
+#define ARM_MAX_CYCLES (1ULL << 28)
+
+/* Mapped registers, or a null pointer if there is no local
+   APIC. */
+static volatile uint32_t *lapic;
+
+/* True if the timer runs in TSC-deadline mode.  Otherwise it runs
+   in one-shot mode, counting down timer_per_tsc / 2**32 per TSC
+   cycle. */
+static bool tsc_deadline;
+static uint64_t timer_per_tsc;
+
+static intr_handler_func spurious_interrupt;
+
+static uint32_t
+lapic_read (int reg) {
+	return lapic[reg / sizeof *lapic];
+}
+
+static void
+lapic_write (int reg, uint32_t value) {
+	lapic[reg / sizeof *lapic] = value;
+	lapic_read (LAPIC_ID);        /* Wait for the write to finish. */
+}
+
+/* Maps and enables the local APIC in virtual wire mode.  Returns
+   false if the CPU has no local APIC. */
+bool
+lapic_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+	uint64_t base, pa, *pte;
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if (!(edx & CPUID_1_EDX_APIC))
+		return false;
+	tsc_deadline = (ecx & CPUID_1_ECX_TSC_DL) != 0;
+
+	base = read_msr (MSR_APIC_BASE);
+	if (!(base & APIC_BASE_ENABLE))
+		write_msr (MSR_APIC_BASE, base | APIC_BASE_ENABLE);
+	pa = base & APIC_BASE_ADDR;
+
+	/* The registers lie outside RAM, so the kernel mapping of
+	   physical memory does not cover them. */
+	pte = pml4e_walk (base_pml4, (uint64_t) ptov (pa), 1);
+	if (pte == NULL)
+		return false;
+	*pte = pa | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+	lapic = ptov (pa);
+	invlpg ((uint64_t) lapic);   /* In case a large page mapped it. */
+
+	intr_register_int (LAPIC_SPURIOUS_VEC, 0, INTR_OFF, spurious_interrupt,
+			"LAPIC Spurious");
+	lapic_write (LAPIC_LVT_LINT0, LVT_EXTINT);
+	lapic_write (LAPIC_LVT_LINT1, LVT_NMI);
+	lapic_write (LAPIC_LVT_TIMER, LVT_MASKED);
+	lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+	return true;
+}
+
+/* Acknowledges the local APIC interrupt being handled. */
+void
+lapic_eoi (void) {
+	lapic_write (LAPIC_EOI, 0);
+}
+
+/* Sets up the timer to raise LAPIC_TIMER_VEC when armed,
+   calibrating it against the TSC if it lacks TSC-deadline mode.
+   Interrupts must be on, since calibration waits for timer
+   ticks.  Returns false if there is no local APIC. */
+bool
+lapic_timer_init (void) {
+	if (lapic == NULL)
+		return false;
+
+	ASSERT (intr_get_level () == INTR_ON);
+
+	if (tsc_deadline) {
+		lapic_write (LAPIC_LVT_TIMER, LVT_TIMER_TSC_DL | LAPIC_TIMER_VEC);
+		/* Order the MMIO write before later writes of the MSR. */
+		asm volatile ("mfence" : : : "memory");
+	} else {
+		uint64_t tsc;
+		uint32_t count;
+		int64_t start;
+
+		lapic_write (LAPIC_TIMER_DCR, DCR_DIV1);
+		lapic_write (LAPIC_LVT_TIMER, LVT_MASKED | LVT_TIMER_ONESHOT);
+
+		start = timer_ticks ();
+		while (timer_ticks () == start)
+			continue;
+		tsc = rdtsc ();
+		lapic_write (LAPIC_TIMER_ICR, UINT32_MAX);
+		while (timer_ticks () < start + 1 + CALIB_TICKS)
+			continue;
+		count = UINT32_MAX - lapic_read (LAPIC_TIMER_CCR);
+		tsc = rdtsc () - tsc;
+		lapic_write (LAPIC_TIMER_ICR, 0);
+
+		if (count == 0 || tsc == 0)
+			return false;
+		timer_per_tsc = ((uint64_t) count << 32) / tsc;
+		lapic_write (LAPIC_LVT_TIMER, LVT_TIMER_ONESHOT | LAPIC_TIMER_VEC);
+	}
+	return true;
+}
+
+/* Arms the timer to interrupt once, as soon as the TSC reaches
+   DEADLINE.  A deadline that has passed interrupts right away.
+   In one-shot mode a distant deadline may interrupt early, and
+   the handler must then re-arm.  Replaces any earlier deadline.
+   Interrupts must be off. */
+void
+lapic_timer_arm (uint64_t deadline) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (tsc_deadline)
+		write_msr (MSR_TSC_DEADLINE, deadline);
+	else {
+		uint64_t now = rdtsc ();
+		uint64_t delta = deadline > now ? deadline - now : 0;
+		uint64_t count;
+
+		if (delta > ARM_MAX_CYCLES)
+			delta = ARM_MAX_CYCLES;
+		count = (delta * timer_per_tsc) >> 32;
+		if (count > UINT32_MAX)
+			count = UINT32_MAX;
+		lapic_write (LAPIC_TIMER_ICR, count != 0 ? count : 1);
+	}
+}
+
+/* Returns true if the timer runs in TSC-deadline mode. */
+bool
+lapic_tsc_deadline (void) {
+	return tsc_deadline;
+}
+
+/* Spurious interrupt handler.  A spurious interrupt must not be
+   acknowledged. */
+static void
+spurious_interrupt (struct intr_frame *f UNUSED) {
+}
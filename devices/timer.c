@@ -3,10 +3,13 @@
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include "devices/hrtimer.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/softirq.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -17,18 +20,62 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
-/* Number of timer ticks since OS booted. */
+/* 8254 input frequency and the PIT count for one timer tick. */
+#define PIT_HZ 1193180
+#define PIT_TICK_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Longest one-shot, in ticks, that fits the 8254's 16-bit counter. */
+#define NOHZ_MAX_TICKS (0xffff / PIT_TICK_COUNT)
+
+/* Number of timer ticks since OS booted.  Written only with
+   ticks_seq held for writing, so timer_ticks() can read it
+   without disabling interrupts. */
 static int64_t ticks;
+static struct seqlock ticks_seq;
+
+/* Earliest tick at which a sleeping thread must be woken. */
 static int64_t global_tick = INT64_MAX;
 
+/* Wakes the sleepers that are due, after the timer interrupt. */
+static struct softirq wake_softirq;
+static softirq_func timer_wake;
+
+/* If false (default), the timer interrupts TIMER_FREQ times per
+   second no matter what.  If true, the periodic tick is stopped
+   while the CPU is idle.  Controlled by kernel command-line
+   option "-nohz". */
+bool timer_nohz;
+
+/* Number of ticks covered by the one-shot currently programmed
+   into the PIT, or 0 if the PIT is in periodic mode. */
+static int64_t nohz_ticks;
+
+/* PIT input clocks of the one-shot currently programmed. */
+static int64_t nohz_armed;
+
+/* PIT input clocks that have passed but are not yet counted in
+   `ticks', less than PIT_TICK_COUNT outside of tickless idle.
+   Timer interrupts keep `ticks' in step, so this only changes
+   when tickless idle starts or ends between two of them. */
+static int64_t nohz_carry;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Time stamp counter and tick count at the end of
+   timer_calibrate(), the baseline for timer_tsc_hz(). */
+static uint64_t calib_tsc;
+static int64_t calib_ticks;
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
+static void pit_set_periodic (void);
+static void pit_set_oneshot (uint16_t count);
+static uint16_t pit_read_count (void);
+static bool pit_read_back (uint16_t *count);
 
 void timer_sleep (int64_t ticks);
 
@@ -37,14 +84,9 @@ void timer_sleep (int64_t ticks);
    corresponding interrupt. */
 void
 timer_init (void) {
-	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb (0x40, count & 0xff);
-	outb (0x40, count >> 8);
-
+	seqlock_init (&ticks_seq);
+	softirq_init (&wake_softirq, timer_wake, NULL);
+	pit_set_periodic ();
 	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -71,15 +113,31 @@ timer_calibrate (void) {
 			loops_per_tick |= test_bit;
 
 	printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+	calib_ticks = timer_ticks ();
+	calib_tsc = rdtsc ();
+}
+
+/* Returns the time stamp counter frequency in Hz, measured
+   against the timer since timer_calibrate(), or 0 if no tick has
+   passed yet.  The estimate sharpens the longer the system runs. */
+uint64_t
+timer_tsc_hz (void) {
+	int64_t elapsed = timer_ticks () - calib_ticks;
+
+	return elapsed > 0 ? (rdtsc () - calib_tsc) / elapsed * TIMER_FREQ : 0;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
 int64_t
 timer_ticks (void) {
-	enum intr_level old_level = intr_disable ();
-	int64_t t = ticks;
-	intr_set_level (old_level);
-	barrier ();
+	unsigned seq;
+	int64_t t;
+
+	do {
+		seq = seqlock_read_begin (&ticks_seq);
+		t = ticks;
+	} while (seqlock_read_retry (&ticks_seq, seq));
 	return t;
 }
 
@@ -94,16 +152,31 @@ timer_elapsed (int64_t then) {
 void
 timer_sleep (int64_t ticks) {
 	int64_t start = timer_ticks ();
+	enum intr_level old_level;
 
 	ASSERT (intr_get_level () == INTR_ON);
 
-	if (timer_elapsed (start) < ticks){
-		if(start + ticks < global_tick)
-			global_tick = start + ticks;
-		thread_sleep(start + ticks);
+	if (timer_elapsed (start) < ticks) {
+		old_level = intr_disable ();
+		timer_sleep_until (start + ticks);
+		intr_set_level (old_level);
 	}
 }
 
+/* Suspends execution until the timer reaches tick WAKE_TIME.
+   Interrupts must be off, so that global_tick is lowered and the
+   sleep armed atomically: otherwise the timer interrupt could
+   overwrite global_tick in between with a deadline that does not
+   account for us. */
+void
+timer_sleep_until (int64_t wake_time) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (wake_time < global_tick)
+		global_tick = wake_time;
+	thread_sleep (wake_time);
+}
+
 /* Suspends execution for approximately MS milliseconds. */
 void
 timer_msleep (int64_t ms) {
@@ -122,6 +195,74 @@ timer_nsleep (int64_t ns) {
 	real_time_sleep (ns, 1000 * 1000 * 1000);
 }
 
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  In tickless mode, replaces the periodic tick by
+   a single interrupt at the next sleeper's wake time (or as far
+   ahead as the PIT can count, if that is sooner).  The part of
+   the current tick that has already passed is added to
+   nohz_carry, and the one-shot is shortened by all of
+   nohz_carry, so that it ends on a tick boundary. */
+void
+timer_idle_enter (void) {
+	int64_t delta;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!timer_nohz || nohz_ticks != 0)
+		return;
+
+	delta = global_tick - ticks;
+	if (delta < 2)
+		return;
+	if (delta > NOHZ_MAX_TICKS)
+		delta = NOHZ_MAX_TICKS;
+
+	nohz_carry += PIT_TICK_COUNT - pit_read_count ();
+	nohz_ticks = delta;
+	nohz_armed = delta * PIT_TICK_COUNT - nohz_carry;
+	pit_set_oneshot (nohz_armed);
+}
+
+/* Called on entry to every external interrupt, with interrupts
+   off, so that a one-shot programmed by timer_idle_enter() ends
+   as soon as anything, not just the idle thread's next pass,
+   interrupts the idle CPU: a thread the interrupt wakes then sees
+   an up-to-date `ticks' and gets its time-slice ticks.  Catches
+   `ticks' up by the whole ticks that passed, keeps the rest in
+   nohz_carry so that early wake-ups do not lose time, and
+   restarts the periodic tick.  No sleeper can be due yet, unless
+   the one-shot expired, because it was programmed not to outlast
+   global_tick. */
+void
+timer_idle_exit (void) {
+	enum intr_level old_level;
+	uint16_t count;
+	int64_t elapsed;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (nohz_ticks == 0)
+		return;
+
+	if (pit_read_back (&count) || count == 0) {
+		/* The one-shot expired.  Its interrupt is the one being
+		   handled, or is still pending at the PIC, and accounts for
+		   one tick as an ordinary one.  After reaching 0, the
+		   counter keeps counting down from 0xffff, which measures
+		   how late we are by up to 55 ms. */
+		elapsed = nohz_armed + (uint16_t) -count - PIT_TICK_COUNT;
+	} else
+		elapsed = nohz_armed - count;
+
+	elapsed += nohz_carry;
+	old_level = seqlock_write_begin (&ticks_seq);
+	ticks += elapsed / PIT_TICK_COUNT;
+	seqlock_write_end (&ticks_seq, old_level);
+	nohz_carry = elapsed % PIT_TICK_COUNT;
+	nohz_ticks = 0;
+	pit_set_periodic ();
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) {
@@ -131,15 +272,70 @@ timer_print_stats (void) {
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED) {
+	enum intr_level old_level = seqlock_write_begin (&ticks_seq);
+
+	/* timer_idle_exit() has already ended any one-shot. */
+	ASSERT (nohz_ticks == 0);
 	ticks++;
+	seqlock_write_end (&ticks_seq, old_level);
 	thread_tick ();
-	/* check sleep list and the global tick
-		find any threads to wake up,
-		move them to the ready list if necessary
-		update the global tick
-	*/
 	if (global_tick <= ticks)
-		global_tick = thread_wake(ticks);
+		softirq_raise (&wake_softirq);
+}
+
+/* Timer softirq: wakes the sleeping threads that are due and
+   lowers global_tick to the next thread_wake() deadline. */
+static void
+timer_wake (void *aux UNUSED) {
+	enum intr_level old_level = intr_disable ();
+
+	global_tick = thread_wake (ticks);
+	intr_set_level (old_level);
+}
+
+/* Programs PIT counter 0 to interrupt TIMER_FREQ times per
+   second. */
+static void
+pit_set_periodic (void) {
+	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+	outb (0x40, PIT_TICK_COUNT & 0xff);
+	outb (0x40, PIT_TICK_COUNT >> 8);
+}
+
+/* Programs PIT counter 0 to interrupt once, COUNT input clocks
+   from now. */
+static void
+pit_set_oneshot (uint16_t count) {
+	outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary. */
+	outb (0x40, count & 0xff);
+	outb (0x40, count >> 8);
+}
+
+/* Returns the current value of PIT counter 0. */
+static uint16_t
+pit_read_count (void) {
+	uint8_t lo, hi;
+
+	outb (0x43, 0x00);    /* CW: latch counter 0. */
+	lo = inb (0x40);
+	hi = inb (0x40);
+	return (hi << 8) | lo;
+}
+
+/* Reads back PIT counter 0's status and count, storing the count
+   in *COUNT.  Returns the state of the counter's OUT pin, which
+   in mode 0 goes high once the count reaches 0 and stays high
+   until the counter is reprogrammed. */
+static bool
+pit_read_back (uint16_t *count) {
+	uint8_t status, lo, hi;
+
+	outb (0x43, 0xc2);    /* Read-back: latch status and count of counter 0. */
+	status = inb (0x40);
+	lo = inb (0x40);
+	hi = inb (0x40);
+	*count = (hi << 8) | lo;
+	return (status & 0x80) != 0;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -190,8 +386,12 @@ real_time_sleep (int64_t num, int32_t denom) {
 		   timer_sleep() because it will yield the CPU to other
 		   processes. */
 		timer_sleep (ticks);
+	} else if (hrtimer_available ()) {
+		/* Otherwise, block until the local APIC timer wakes us,
+		   which is accurate to well under a tick. */
+		hrtimer_nsleep (num * (1000 * 1000 * 1000 / denom));
 	} else {
-		/* Otherwise, use a busy-wait loop for more accurate
+		/* Without one, use a busy-wait loop for more accurate
 		   sub-tick timing.  We scale the numerator and denominator
 		   down by 1000 to avoid the possibility of overflow. */
 		ASSERT (denom % 1000 == 0);
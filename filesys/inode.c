@@ -6,6 +6,8 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -33,6 +35,7 @@ struct inode {
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	struct rwlock rwlock;               /* Guards directory entries. */
 	struct inode_disk data;             /* Inode content. */
 };
 
@@ -50,13 +53,41 @@ byte_to_sector (const struct inode *inode, off_t pos) {
 }
 
 /* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
+ * returns the same `struct inode'.
+ *
+ * Lookups hold open_inodes_lock for reading, so concurrent opens
+ * of files that are already open do not serialize; inserting and
+ * removing an inode hold it for writing.  An inode's open_cnt is
+ * changed atomically, since readers of the list may bump it
+ * concurrently.  It only drops to zero with the lock held for
+ * writing, so an inode found on the list is never being freed. */
 static struct list open_inodes;
+static struct rwlock open_inodes_lock;
+
+/* Cache of `struct inode's. */
+static struct kmem_cache *inode_cache;
+
+static struct inode *find_open_inode (disk_sector_t);
+static kmem_ctor_func inode_ctor;
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
 	list_init (&open_inodes);
+	rwlock_init (&open_inodes_lock);
+	inode_cache = kmem_cache_create ("inode", sizeof (struct inode), 0,
+			inode_ctor);
+	if (inode_cache == NULL)
+		PANIC ("inode cache creation failed");
+}
+
+/* Constructs the inode at INODE_, initializing the fields that
+ * are back in their initial state whenever the inode is freed. */
+static void
+inode_ctor (void *inode_) {
+	struct inode *inode = inode_;
+
+	rwlock_init (&inode->rwlock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -101,23 +132,26 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
 	struct inode *inode;
 
 	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
-	}
+	rwlock_read_acquire (&open_inodes_lock);
+	inode = inode_reopen (find_open_inode (sector));
+	rwlock_read_release (&open_inodes_lock);
+	if (inode != NULL)
+		return inode;
+
+	/* Not open.  Look again with the list locked for writing,
+	 * since another thread may have opened it meanwhile. */
+	rwlock_write_acquire (&open_inodes_lock);
+	inode = inode_reopen (find_open_inode (sector));
+	if (inode != NULL)
+		goto done;
 
 	/* Allocate memory. */
-	inode = malloc (sizeof *inode);
+	inode = kmem_cache_alloc (inode_cache);
 	if (inode == NULL)
-		return NULL;
+		goto done;
 
 	/* Initialize. */
 	list_push_front (&open_inodes, &inode->elem);
@@ -126,14 +160,32 @@ inode_open (disk_sector_t sector) {
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
 	disk_read (filesys_disk, inode->sector, &inode->data);
+
+done:
+	rwlock_write_release (&open_inodes_lock);
 	return inode;
 }
 
+/* Returns the open inode for SECTOR, or a null pointer if it is
+ * not open.  open_inodes_lock must be held. */
+static struct inode *
+find_open_inode (disk_sector_t sector) {
+	struct list_elem *e;
+
+	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+			e = list_next (e)) {
+		struct inode *inode = list_entry (e, struct inode, elem);
+		if (inode->sector == sector)
+			return inode;
+	}
+	return NULL;
+}
+
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
 	if (inode != NULL)
-		inode->open_cnt++;
+		__atomic_add_fetch (&inode->open_cnt, 1, __ATOMIC_RELAXED);
 	return inode;
 }
 
@@ -143,6 +195,13 @@ inode_get_inumber (const struct inode *inode) {
 	return inode->sector;
 }
 
+/* Returns the reader-writer lock that guards the entries of
+ * INODE, if it is a directory. */
+struct rwlock *
+inode_get_rwlock (struct inode *inode) {
+	return &inode->rwlock;
+}
+
 /* Closes INODE and writes it to disk.
  * If this was the last reference to INODE, frees its memory.
  * If INODE was also a removed inode, frees its blocks. */
@@ -153,9 +212,11 @@ inode_close (struct inode *inode) {
 		return;
 
 	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
+	rwlock_write_acquire (&open_inodes_lock);
+	if (__atomic_sub_fetch (&inode->open_cnt, 1, __ATOMIC_RELAXED) == 0) {
 		/* Remove from inode list and release lock. */
 		list_remove (&inode->elem);
+		rwlock_write_release (&open_inodes_lock);
 
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
@@ -164,8 +225,9 @@ inode_close (struct inode *inode) {
 					bytes_to_sectors (inode->data.length)); 
 		}
 
-		free (inode); 
-	}
+		kmem_cache_free (inode_cache, inode);
+	} else
+		rwlock_write_release (&open_inodes_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -0,0 +1,12 @@
+#ifndef DEVICES_HRTIMER_H
+#define DEVICES_HRTIMER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void hrtimer_init (void);
+bool hrtimer_available (void);
+void hrtimer_nsleep (int64_t ns);
+void hrtimer_print_stats (void);
+
+#endif /* devices/hrtimer.h */
@@ -0,0 +1,20 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Interrupt vectors of the local APIC.  External interrupts
+   0x20...0x2f come from the 8259A PICs, 0x30...0x3f from the
+   local APIC. */
+#define LAPIC_TIMER_VEC 0x30            /* Local APIC timer. */
+#define LAPIC_SPURIOUS_VEC 0xff         /* Spurious interrupt. */
+
+bool lapic_init (void);
+void lapic_eoi (void);
+
+bool lapic_timer_init (void);
+void lapic_timer_arm (uint64_t deadline);
+bool lapic_tsc_deadline (void);
+
+#endif /* devices/lapic.h */
@@ -50,6 +50,28 @@ static __inline uint64_t rcr3(void) {
 	return val;
 }
 
+__attribute__((always_inline))
+static __inline uint64_t rcr4(void) {
+	uint64_t val;
+	__asm __volatile("movq %%cr4,%0" : "=r" (val));
+	return val;
+}
+
+__attribute__((always_inline))
+static __inline void lcr4(uint64_t val) {
+	__asm __volatile("movq %0, %%cr4" : : "r" (val) : "memory");
+}
+
+/* Invalidates TLB entries tagged with process-context identifier
+   PCID, as selected by TYPE: only the one for ADDR (type 0), all
+   of them (type 1), or those for every PCID (type 2).  See
+   [IA32-v2a] "INVPCID--Invalidate Process-Context Identifier". */
+__attribute__((always_inline))
+static __inline void invpcid(uint64_t type, uint64_t pcid, uint64_t addr) {
+	struct { uint64_t pcid, addr; } desc = { pcid, addr };
+	__asm __volatile("invpcid %0, %1" : : "m" (desc), "r" (type) : "memory");
+}
+
 __attribute__((always_inline))
 static __inline uint64_t rrax(void) {
 	uint64_t val;
@@ -119,6 +141,52 @@ static __inline uint64_t rcr2(void) {
 	return val;
 }
 
+/* Returns the index of the most significant set bit of VAL,
+   which must be nonzero.  See [IA32-v2a] "BSR--Bit Scan Reverse". */
+__attribute__((always_inline))
+static __inline uint64_t bsrq(uint64_t val) {
+	uint64_t idx;
+	__asm __volatile("bsrq %1, %0" : "=r" (idx) : "rm" (val) : "cc");
+	return idx;
+}
+
+/* Returns the index of the least significant set bit of VAL,
+   which must be nonzero.  See [IA32-v2a] "BSF--Bit Scan Forward". */
+__attribute__((always_inline))
+static __inline uint64_t bsfq(uint64_t val) {
+	uint64_t idx;
+	__asm __volatile("bsfq %1, %0" : "=r" (idx) : "rm" (val) : "cc");
+	return idx;
+}
+
+/* Returns the processor's time-stamp counter.  See [IA32-v2b]
+   "RDTSC--Read Time-Stamp Counter". */
+__attribute__((always_inline))
+static __inline uint64_t rdtsc(void) {
+	uint32_t lo, hi;
+	__asm __volatile("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+
+/* Returns the model-specific register ECX.  See [IA32-v2b]
+   "RDMSR--Read from Model Specific Register". */
+__attribute__((always_inline))
+static __inline uint64_t read_msr(uint32_t ecx) {
+	uint32_t edx, eax;
+	__asm __volatile("rdmsr" : "=d" (edx), "=a" (eax) : "c" (ecx));
+	return ((uint64_t) edx << 32) | eax;
+}
+
+/* Executes CPUID for LEAF, storing the four result registers.
+   See [IA32-v2a] "CPUID--CPU Identification". */
+__attribute__((always_inline))
+static __inline void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx,
+		uint32_t *ecx, uint32_t *edx) {
+	__asm __volatile("cpuid"
+			: "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+			: "a" (leaf), "c" (0));
+}
+
 __attribute__((always_inline))
 static __inline void write_msr(uint32_t ecx, uint64_t val) {
 	uint32_t edx, eax;
@@ -0,0 +1,63 @@
+#ifndef __LIB_KERNEL_PHEAP_H
+#define __LIB_KERNEL_PHEAP_H
+
+/* Pairing heap.
+ *
+ * A max-heap that, like struct list, needs no dynamically
+ * allocated memory: each structure that may be in a heap embeds
+ * a struct pheap_elem, and pheap_entry() converts back from the
+ * element to the enclosing structure.
+ *
+ * Insertion and finding the maximum are O(1); removing the
+ * maximum, removing an arbitrary element, and re-keying an
+ * element whose key changed are O(log n) amortized.  Elements
+ * that compare equal come out in the order they were inserted.
+ *
+ * The ordering is given by a less function, as for list_sort():
+ * pheap_max() is an element that no other element is greater
+ * than. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct pheap_elem {
+	struct pheap_elem *child;   /* First child. */
+	struct pheap_elem *next;    /* Next sibling. */
+	struct pheap_elem *prev;    /* Previous sibling, or parent if first. */
+	uint64_t seq;               /* Insertion order, to break ties. */
+};
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool pheap_less_func (const struct pheap_elem *a,
+                              const struct pheap_elem *b,
+                              void *aux);
+
+/* Heap. */
+struct pheap {
+	struct pheap_elem *root;    /* Maximum element, or NULL if empty. */
+	pheap_less_func *less;      /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `less'. */
+	uint64_t next_seq;          /* Sequence number for next insertion. */
+};
+
+/* Converts pointer to heap element PHEAP_ELEM into a pointer to
+   the structure that PHEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define pheap_entry(PHEAP_ELEM, STRUCT, MEMBER)         \
+	((STRUCT *) ((uint8_t *) &(PHEAP_ELEM)->child   \
+		- offsetof (STRUCT, MEMBER.child)))
+
+void pheap_init (struct pheap *, pheap_less_func *, void *aux);
+bool pheap_empty (const struct pheap *);
+struct pheap_elem *pheap_max (const struct pheap *);
+void pheap_push (struct pheap *, struct pheap_elem *);
+struct pheap_elem *pheap_pop (struct pheap *);
+void pheap_remove (struct pheap *, struct pheap_elem *);
+void pheap_update (struct pheap *, struct pheap_elem *);
+
+#endif /* lib/kernel/pheap.h */
@@ -0,0 +1,21 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+#include <stdint.h>
+
+/* Values for the WHO argument to getrusage().  A process has
+   exactly one thread, so both report the same numbers. */
+#define RUSAGE_SELF 0           /* The calling process. */
+#define RUSAGE_THREAD 1         /* The calling thread. */
+
+/* CPU time used, as filled in by getrusage().  Times are
+   measured with the time stamp counter at every context switch
+   and every user/kernel transition, not sampled at timer ticks. */
+struct rusage {
+	uint64_t utime_us;          /* Microseconds in user mode. */
+	uint64_t stime_us;          /* Microseconds in kernel mode. */
+	uint64_t ucycles;           /* TSC cycles in user mode. */
+	uint64_t scycles;           /* TSC cycles in kernel mode. */
+};
+
+#endif /* lib/rusage.h */
@@ -36,6 +36,15 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extra: CPU accounting. */
+	SYS_GETRUSAGE,              /* Report CPU time used. */
+
+	/* Extra: user-level synchronization. */
+	SYS_FUTEX,                  /* Wait on or wake a futex word. */
+
+	/* Extra: CPU shares. */
+	SYS_GROUP_NEW,              /* Start a new scheduling group. */
 };
 
 #endif /* lib/syscall-nr.h */
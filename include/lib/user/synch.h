@@ -0,0 +1,35 @@
+#ifndef __LIB_USER_SYNCH_H
+#define __LIB_USER_SYNCH_H
+
+/* User-level mutexes and condition variables built on futex().
+   Locking and unlocking an uncontended mutex takes no system
+   call; a thread that must wait sleeps in the kernel instead of
+   spinning. */
+
+/* Mutex.  STATE is 0 if unlocked, 1 if locked with no waiters,
+   and 2 if locked with possible waiters. */
+struct mutex {
+	int state;
+};
+
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+/* Condition variable.  SEQ is bumped by every signal, so a
+   waiter that went to sleep on an old value is not left
+   sleeping by a signal that raced with its wait. */
+struct condvar {
+	int seq;
+};
+
+#define CONDVAR_INITIALIZER { 0 }
+
+void condvar_init (struct condvar *);
+void condvar_wait (struct condvar *, struct mutex *);
+void condvar_signal (struct condvar *);
+void condvar_broadcast (struct condvar *);
+
+#endif /* lib/user/synch.h */
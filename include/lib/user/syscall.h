@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <futex.h>
+#include <rusage.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -50,6 +52,15 @@ bool isdir (int fd);
 int inumber (int fd);
 int symlink (const char* target, const char* linkpath);
 
+/* Extra: CPU accounting. */
+int getrusage (int who, struct rusage *usage);
+
+/* Extra: user-level synchronization.  See <synch.h>. */
+int futex (int *addr, int op, int val);
+
+/* Extra: CPU shares. */
+bool group_new (unsigned weight);
+
 static inline void* get_phys_addr (void *user_addr) {
 	void* pa;
 	asm volatile ("movq %0, %%rax" ::"r"(user_addr));
@@ -0,0 +1,50 @@
+#ifndef THREADS_LOCKSTAT_H
+#define THREADS_LOCKSTAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Lock contention profiling.
+ *
+ * Every semaphore and lock belongs to a class: all of those
+ * initialized by the same sema_init() or lock_init() call site
+ * share one, so that, for example, the locks of all malloc
+ * descriptors are counted together.  Once the "lockstat" action
+ * turns profiling on, sema_down() and lock_acquire() count
+ * acquisitions, contended acquisitions and cycles spent waiting,
+ * and lock_release() counts cycles the lock was held.  The
+ * classes that waited longest are printed at power off.
+ *
+ * While profiling is off, each hook costs one predictable
+ * branch. */
+
+/* A lock class and its statistics, in TSC cycles.  Statistics
+   are only updated with interrupts off. */
+struct lock_class {
+	const char *name;           /* Argument to sema_init() or lock_init(). */
+	const char *file;           /* Source file of the call site. */
+	int line;                   /* Source line of the call site. */
+	struct lock_class *next;    /* Next registered class. */
+	bool registered;            /* On the list of classes? */
+
+	uint64_t acquired;          /* # of acquisitions. */
+	uint64_t contended;         /* # of acquisitions that had to wait. */
+	uint64_t wait_cycles;       /* Total cycles spent waiting. */
+	uint64_t wait_max;          /* Longest single wait. */
+	uint64_t hold_cycles;       /* Total cycles held (locks only). */
+};
+
+/* Initializer for the lock class of a call site. */
+#define LOCK_CLASS_INITIALIZER(NAME) \
+	{ .name = (NAME), .file = __FILE__, .line = __LINE__ }
+
+extern bool lockstat_enabled;
+
+void lockstat_register (struct lock_class *);
+void lockstat_acquired (struct lock_class *, uint64_t wait_cycles,
+		bool contended);
+void lockstat_released (struct lock_class *, uint64_t hold_cycles);
+void lockstat_start (char **argv);
+void lockstat_print_stats (void);
+
+#endif /* threads/lockstat.h */
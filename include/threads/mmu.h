@@ -8,12 +8,19 @@
 typedef bool pte_for_each_func (uint64_t *pte, void *va, void *aux);
 
 uint64_t *pml4e_walk (uint64_t *pml4, const uint64_t va, int create);
+uint64_t *pml4e_lookup (uint64_t *pml4, const uint64_t va, uint64_t *size);
+uint64_t *pml4e_walk_large (uint64_t *pml4, const uint64_t va, uint64_t size,
+		int create);
 uint64_t *pml4_create (void);
 bool pml4_for_each (uint64_t *, pte_for_each_func *, void *);
 void pml4_destroy (uint64_t *pml4);
 void pml4_activate (uint64_t *pml4);
+void pml4_init_pcid (void);
 void *pml4_get_page (uint64_t *pml4, const void *upage);
 bool pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw);
+bool pml4_set_huge_page (uint64_t *pml4, void *upage, void *kpage, bool rw);
+bool pml4_split_huge_page (uint64_t *pml4, void *upage);
+bool pml4_promote_huge_page (uint64_t *pml4, void *upage);
 void pml4_clear_page (uint64_t *pml4, void *upage);
 bool pml4_is_dirty (uint64_t *pml4, const void *upage);
 void pml4_set_dirty (uint64_t *pml4, const void *upage, bool dirty);
@@ -26,6 +33,10 @@ void pml4_set_accessed (uint64_t *pml4, const void *upage, bool accessed);
 
 #define pte_get_paddr(pte) (pg_round_down(*(pte)))
 
+/* Round down to the nearest 2 MB huge page boundary. */
+#define pg_round_down_huge(va) \
+	((void *) ((uint64_t) (va) & ~(PDE_PGSIZE - 1)))
+
 /* Segment descriptors for x86-64. */
 struct desc_ptr {
 	uint16_t size;
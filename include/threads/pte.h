@@ -28,6 +28,12 @@
 #define PTX(la)  ((((uint64_t) (la)) >> PTXSHIFT) & 0x1FF)
 #define PTE_ADDR(pte) ((uint64_t) (pte) & ~0xFFF)
 
+/* Bytes mapped by a PTE, by a large-page PDE, and by a large-page
+ * PDPE. */
+#define PTE_PGSIZE  (1UL << PTXSHIFT)    /* 4 kB. */
+#define PDE_PGSIZE  (1UL << PDXSHIFT)    /* 2 MB. */
+#define PDPE_PGSIZE (1UL << PDPESHIFT)   /* 1 GB. */
+
 /* The important flags are listed below.
    When a PDE or PTE is not "present", the other flags are
    ignored.
@@ -39,7 +45,10 @@
 #define PTE_P 0x1                        /* 1=present, 0=not present. */
 #define PTE_W 0x2                        /* 1=read/write, 0=read-only. */
 #define PTE_U 0x4                        /* 1=user/kernel, 0=kernel only. */
+#define PTE_PWT 0x8                      /* 1=write-through, 0=write-back. */
+#define PTE_PCD 0x10                     /* 1=cache disabled, 0=enabled. */
 #define PTE_A 0x20                       /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40                       /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80                      /* 1=large page (PDEs and PDPEs only). */
 
 #endif /* threads/pte.h */
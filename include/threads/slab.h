@@ -0,0 +1,22 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* Object caches for kernel objects of a single type.
+
+   A cache hands out objects of one size, packed into slabs of
+   contiguous pages without malloc()'s power-of-2 rounding.  A
+   cache's constructor, if any, runs once when a slab is created,
+   not on every allocation: objects must be returned to the cache
+   in their constructed state, so that fields such as embedded
+   locks need not be initialized again. */
+typedef void kmem_ctor_func (void *obj);
+
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+		size_t align, kmem_ctor_func *ctor);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *obj);
+void kmem_cache_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -0,0 +1,31 @@
+#ifndef THREADS_SOFTIRQ_H
+#define THREADS_SOFTIRQ_H
+
+#include <stdbool.h>
+
+/* Deferred work ("bottom half") of an interrupt handler.
+
+   A handler does only what cannot wait, such as acknowledging
+   the device, and raises a softirq for the rest.  Raised softirqs
+   run in FIFO order just before the interrupt returns, after the
+   PIC has been acknowledged and with interrupts enabled, so that
+   a long bottom half delays neither other interrupts nor the
+   timer.  Softirq functions run on the interrupted thread's stack
+   and, like interrupt handlers, may not sleep; they may call
+   intr_yield_on_return(). */
+typedef void softirq_func (void *aux);
+
+struct softirq {
+	struct softirq *next;       /* Next pending softirq. */
+	softirq_func *func;         /* Function to run. */
+	void *aux;                  /* Argument to FUNC. */
+	bool pending;               /* Raised but not yet run? */
+};
+
+void softirq_init (struct softirq *, softirq_func *, void *aux);
+void softirq_raise (struct softirq *);
+void softirq_run (void);
+bool softirq_context (void);
+void softirq_print_stats (void);
+
+#endif /* threads/softirq.h */
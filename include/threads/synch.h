@@ -2,15 +2,28 @@
 #define THREADS_SYNCH_H
 
 #include <list.h>
+#include <pheap.h>
 #include <stdbool.h>
+#include "threads/interrupt.h"
+#include "threads/lockstat.h"
 
 /* A counting semaphore. */
 struct semaphore {
 	unsigned value;             /* Current value. */
-	struct list waiters;        /* List of waiting threads. */
+	struct pheap waiters;       /* Waiting threads, by priority. */
+	struct lock_class *class;   /* Class for lock profiling. */
 };
 
-void sema_init (struct semaphore *, unsigned value);
+/* Initializes semaphore SEMA to VALUE, in a lock class of its
+   own call site. */
+#define sema_init(SEMA, VALUE)                                          \
+	do {                                                                \
+		static struct lock_class class_ = LOCK_CLASS_INITIALIZER (#SEMA); \
+		sema_init_class ((SEMA), (VALUE), &class_);                     \
+	} while (0)
+
+void sema_init_class (struct semaphore *, unsigned value,
+		struct lock_class *);
 void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
@@ -20,9 +33,17 @@ void sema_self_test (void);
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	uint64_t acquire_tsc;       /* TSC at acquisition, if profiling. */
 };
 
-void lock_init (struct lock *);
+/* Initializes LOCK, in a lock class of its own call site. */
+#define lock_init(LOCK)                                                 \
+	do {                                                                \
+		static struct lock_class class_ = LOCK_CLASS_INITIALIZER (#LOCK); \
+		lock_init_class ((LOCK), &class_);                              \
+	} while (0)
+
+void lock_init_class (struct lock *, struct lock_class *);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
@@ -30,7 +51,7 @@ bool lock_held_by_current_thread (const struct lock *);
 
 /* Condition variable. */
 struct condition {
-	struct list waiters;        /* List of waiting threads. */
+	struct pheap waiters;       /* Waiting threads, by priority. */
 };
 
 void cond_init (struct condition *);
@@ -38,6 +59,70 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Spin lock.  Busy-waits instead of sleeping, so it may be
+   acquired in an interrupt handler.  Acquiring a spin lock also
+   disables interrupts on the local CPU, so that its holder cannot
+   be preempted or interrupted by code that wants the same lock.
+   Hold spin locks only for a few instructions. */
+struct spinlock {
+	volatile int locked;        /* 1 if held, 0 if free. */
+};
+
+void spinlock_init (struct spinlock *);
+enum intr_level spinlock_acquire (struct spinlock *);
+void spinlock_release (struct spinlock *, enum intr_level);
+
+/* Reader-writer lock.  Any number of readers or a single writer
+   may hold it at once.  Writers are preferred: once a writer
+   waits, new readers queue behind it, so a steady stream of
+   readers cannot starve writers.  Ownership is handed directly
+   to the threads a release wakes, highest priority writer
+   first. */
+struct rwlock {
+	int readers;                /* # of readers holding the lock. */
+	struct thread *writer;      /* Writer holding the lock, or NULL. */
+	struct list read_waiters;   /* Readers waiting to acquire. */
+	struct pheap write_waiters; /* Writers waiting, by priority. */
+	struct lock_class *class;   /* Class for lock profiling. */
+};
+
+/* Initializes RW, in a lock class of its own call site. */
+#define rwlock_init(RW)                                                 \
+	do {                                                                \
+		static struct lock_class class_ = LOCK_CLASS_INITIALIZER (#RW); \
+		rwlock_init_class ((RW), &class_);                              \
+	} while (0)
+
+void rwlock_init_class (struct rwlock *, struct lock_class *);
+void rwlock_read_acquire (struct rwlock *);
+void rwlock_read_release (struct rwlock *);
+void rwlock_write_acquire (struct rwlock *);
+void rwlock_write_release (struct rwlock *);
+bool rwlock_held_by_current_thread (const struct rwlock *);
+
+/* Sequence lock, for small read-mostly records.  Writers
+   serialize on a spin lock and bump the sequence number before
+   and after each update, so it is odd while an update is in
+   progress.  Readers never block writers; they read the record
+   optimistically and retry if the sequence number changed:
+
+	unsigned seq;
+	do {
+		seq = seqlock_read_begin (&sl);
+		...copy the record...
+	} while (seqlock_read_retry (&sl, seq));
+*/
+struct seqlock {
+	volatile unsigned seq;      /* Odd while a write is in progress. */
+	struct spinlock lock;       /* Serializes writers. */
+};
+
+void seqlock_init (struct seqlock *);
+unsigned seqlock_read_begin (const struct seqlock *);
+bool seqlock_read_retry (const struct seqlock *, unsigned seq);
+enum intr_level seqlock_write_begin (struct seqlock *);
+void seqlock_write_end (struct seqlock *, enum intr_level);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
@@ -3,7 +3,9 @@
 
 #include <debug.h>
 #include <list.h>
+#include <pheap.h>
 #include <stdint.h>
+#include "threads/fixed-point.h"
 #include "threads/interrupt.h"
 #ifdef VM
 #include "vm/vm.h"
@@ -28,6 +30,18 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, for the MLFQS scheduler. */
+#define NICE_MIN -20                    /* Most willing to run. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Most willing to yield. */
+
+/* Scheduling group weights. */
+#define GROUP_WEIGHT_MIN 1              /* Smallest CPU share. */
+#define GROUP_WEIGHT_DEFAULT 1024       /* Default CPU share. */
+#define GROUP_WEIGHT_MAX 65536          /* Largest CPU share. */
+
+struct sched_group;
+
 /* A kernel thread or user process.
  *
  * Each thread structure is stored in its own 4 kB page.  The
@@ -91,10 +105,30 @@ struct thread {
 	enum thread_status status;          /* Thread state. */
 	char name[16];                      /* Name (for debugging purposes). */
 	int priority;                       /* Priority. */
-	int64_t wake_time;					/* element require for sleep & wake*/
+	int64_t wake_time;                  /* Tick to wake up at, if asleep. */
+	int nice;                           /* MLFQS niceness. */
+	fixed_t recent_cpu;                 /* MLFQS recent CPU usage. */
+	struct list_elem allelem;           /* List element for all threads. */
+	struct list_elem dirty_elem;        /* List element for MLFQS dirty list. */
+	bool dirty;                         /* On the MLFQS dirty list? */
+	struct sched_group *group;          /* Scheduling group. */
+	uint64_t user_cycles;               /* TSC cycles run in user mode. */
+	uint64_t kernel_cycles;             /* TSC cycles run in kernel mode. */
+	uint64_t acct_tsc;                  /* TSC at last accounting point. */
+
+	/* Earliest-deadline-first class, all in timer ticks. */
+	int64_t dl_runtime;                 /* Budget per period, 0 if not EDF. */
+	int64_t dl_deadline;                /* Deadline, relative to period start. */
+	int64_t dl_period;                  /* Period. */
+	int64_t dl_abs_deadline;            /* Deadline of current period. */
+	int64_t dl_next_period;             /* Start of next period. */
+	int64_t dl_budget;                  /* Budget left in current period. */
+	bool dl_throttled;                  /* Out of budget until next period? */
 
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem;              /* List element. */
+	struct pheap_elem waitelem;         /* Element in a waiter or EDF heap. */
+	struct pheap *wait_heap;            /* Waiter heap we are on, if any. */
 
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
@@ -120,6 +154,7 @@ void thread_start (void);
 
 void thread_tick (void);
 void thread_print_stats (void);
+void thread_account (bool user);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -136,6 +171,13 @@ void thread_yield (void);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+bool thread_outranks (const struct thread *, const struct thread *);
+
+bool thread_set_deadline (int64_t runtime, int64_t deadline, int64_t period);
+
+bool thread_group_new (unsigned weight);
+void thread_group_set_weight (unsigned weight);
+unsigned thread_group_get_weight (void);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
@@ -144,8 +186,7 @@ int thread_get_load_avg (void);
 
 void do_iret (struct intr_frame *tf);
 
-void thread_sleep(int64_t ticks);
-int64_t thread_wake(int64_t ticks);
-bool thread_wakeup_tick_less(const struct list_elem *a, const struct list_elem *b, void *aux);
+void thread_sleep (int64_t wake_time);
+int64_t thread_wake (int64_t ticks);
 
 #endif /* threads/thread.h */
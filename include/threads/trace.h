@@ -0,0 +1,43 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Scheduler event tracing.
+ *
+ * When enabled with the "-trace" kernel command-line option, the
+ * events below are recorded, with a TSC timestamp and the tid of
+ * the thread concerned, into a fixed-size ring.  The ring is
+ * printed by the "dump-trace" action, in a format that
+ * utils/trace-latency turns into per-thread wait and run times.
+ *
+ * When tracing is disabled, each trace point costs one
+ * predictable branch. */
+
+/* Traced events.  ARG's meaning depends on the event. */
+enum trace_type {
+	TRACE_SCHEDULE,         /* TID switched in; ARG = prev tid | prev status << 32. */
+	TRACE_WAKEUP,           /* TID made ready; ARG = waker's tid. */
+	TRACE_BLOCK,            /* TID blocked; ARG unused. */
+	TRACE_SEMA_DOWN,        /* TID downs semaphore ARG. */
+	TRACE_SEMA_UP,          /* TID ups semaphore ARG. */
+	TRACE_LOCK_ACQUIRE,     /* TID acquired lock ARG. */
+	TRACE_TYPE_CNT
+};
+
+extern bool trace_enabled;
+
+/* Records event TYPE for thread TID with argument ARG, if tracing
+   is enabled. */
+#define trace_event(TYPE, TID, ARG)                                     \
+	do {                                                                \
+		if (__builtin_expect (trace_enabled, 0))                        \
+			trace_record ((TYPE), (TID), (uint64_t) (ARG));             \
+	} while (0)
+
+void trace_init (void);
+void trace_record (enum trace_type, int tid, uint64_t arg);
+void trace_dump (char **argv);
+
+#endif /* threads/trace.h */
@@ -63,6 +63,44 @@ last_mask (const struct bitmap *b) {
 	return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns the number of bits set in W. */
+static inline size_t
+elem_popcount (elem_type w) {
+	/* Sum bits in pairs, then nibbles, then bytes, and finally add
+	   up the bytes with a multiplication.  __builtin_popcountl()
+	   would call into libgcc, which the kernel does not link. */
+	w = w - ((w >> 1) & 0x5555555555555555UL);
+	w = (w & 0x3333333333333333UL) + ((w >> 2) & 0x3333333333333333UL);
+	w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0fUL;
+	return (w * 0x0101010101010101UL) >> 56;
+}
+
+/* Returns the index of the first bit in B at or after START, and
+   before END, that is set to VALUE, or END if there is none.
+   Works a word at a time, skipping words with no such bit. */
+static size_t
+find_bit (const struct bitmap *b, size_t start, size_t end, bool value) {
+	elem_type flip = value ? 0 : (elem_type) -1;
+	size_t idx, last;
+	elem_type w;
+
+	if (start >= end)
+		return end;
+
+	/* Set the bits equal to VALUE, ignoring those before START. */
+	idx = elem_idx (start);
+	last = elem_idx (end - 1);
+	w = (b->bits[idx] ^ flip) & ((elem_type) -1 << (start % ELEM_BITS));
+	while (w == 0) {
+		if (++idx > last)
+			return end;
+		w = b->bits[idx] ^ flip;
+	}
+
+	start = idx * ELEM_BITS + __builtin_ctzl (w);
+	return start < end ? start : end;
+}
+
 /* Creation and destruction. */
 
 /* Initializes B to be a bitmap of BIT_CNT bits
@@ -211,6 +249,7 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) {
    exclusive, that are set to VALUE. */
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) {
+	size_t end = start + cnt;
 	size_t i, value_cnt;
 
 	ASSERT (b != NULL);
@@ -218,9 +257,16 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) {
 	ASSERT (start + cnt <= b->bit_cnt);
 
 	value_cnt = 0;
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
-			value_cnt++;
+	for (i = start; i < end; ) {
+		size_t ofs = i % ELEM_BITS;
+		size_t n = end - i < ELEM_BITS - ofs ? end - i : ELEM_BITS - ofs;
+		elem_type w = b->bits[elem_idx (i)] >> ofs;
+
+		if (n < ELEM_BITS)
+			w &= ((elem_type) 1 << n) - 1;
+		value_cnt += value ? elem_popcount (w) : n - elem_popcount (w);
+		i += n;
+	}
 	return value_cnt;
 }
 
@@ -228,16 +274,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) {
    exclusive, are set to VALUE, and false otherwise. */
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i;
-
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
-			return true;
-	return false;
+	return find_bit (b, start, start + cnt, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -272,12 +313,23 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) {
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 
-	if (cnt <= b->bit_cnt) {
-		size_t last = b->bit_cnt - cnt;
-		size_t i;
-		for (i = start; i <= last; i++)
-			if (!bitmap_contains (b, i, cnt, !value))
-				return i;
+	if (cnt == 0)
+		return start;
+
+	/* Find a bit set to VALUE, then check the CNT - 1 bits after it.
+	   If one of them is not, the group cannot start before it, so
+	   resume the search just past it.  Each word is thus examined
+	   a bounded number of times, however long the group. */
+	while (cnt <= b->bit_cnt - start) {
+		size_t mismatch;
+
+		start = find_bit (b, start, b->bit_cnt - cnt + 1, value);
+		if (start > b->bit_cnt - cnt)
+			break;
+		mismatch = find_bit (b, start + 1, start + cnt, !value);
+		if (mismatch == start + cnt)
+			return start;
+		start = mismatch + 1;
 	}
 	return BITMAP_ERROR;
 }
@@ -296,6 +348,39 @@ bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value) {
 		bitmap_set_multiple (b, idx, cnt, !value);
 	return idx;
 }
+
+/* Like bitmap_scan(), but starts at *HINT and wraps around to the
+   beginning of B, and on success advances *HINT just past the
+   group found.  Keeping HINT between calls makes successive
+   scans resume where the last one left off ("next fit"), instead
+   of passing over the same groups of bits every time. */
+size_t
+bitmap_scan_next (const struct bitmap *b, size_t *hint, size_t cnt,
+		bool value) {
+	size_t idx;
+
+	ASSERT (hint != NULL);
+
+	if (*hint > b->bit_cnt)
+		*hint = 0;
+	idx = bitmap_scan (b, *hint, cnt, value);
+	if (idx == BITMAP_ERROR && *hint > 0)
+		idx = bitmap_scan (b, 0, cnt, value);
+	if (idx != BITMAP_ERROR)
+		*hint = idx + cnt;
+	return idx;
+}
+
+/* Like bitmap_scan_and_flip(), but scans as bitmap_scan_next()
+   does. */
+size_t
+bitmap_scan_next_and_flip (struct bitmap *b, size_t *hint, size_t cnt,
+		bool value) {
+	size_t idx = bitmap_scan_next (b, hint, cnt, value);
+	if (idx != BITMAP_ERROR)
+		bitmap_set_multiple (b, idx, cnt, !value);
+	return idx;
+}
 
 /* File input and output. */
 
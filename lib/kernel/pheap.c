@@ -0,0 +1,160 @@
+#include "pheap.h"
+#include "../debug.h"
+
+/* Pairing heap, after Fredman, Sedgewick, Sleator and Tarjan,
+   "The Pairing Heap: A New Form of Self-Adjusting Heap".
+
+   Each node's children form a doubly linked sibling list headed
+   by its `child' member.  The first child's `prev' points to the
+   parent, which is how a node tells whether it is a first child:
+   E->prev->child == E. */
+
+/* Returns true if element A ranks below element B in heap H:
+   smaller, or equal and inserted later. */
+static bool
+below (const struct pheap *h,
+		const struct pheap_elem *a, const struct pheap_elem *b) {
+	if (h->less (a, b, h->aux))
+		return true;
+	if (h->less (b, a, h->aux))
+		return false;
+	return a->seq > b->seq;
+}
+
+/* Links trees A and B, either of which may be null, and returns
+   the root of the result. */
+static struct pheap_elem *
+meld (const struct pheap *h, struct pheap_elem *a, struct pheap_elem *b) {
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+	if (below (h, a, b)) {
+		struct pheap_elem *t = a;
+		a = b;
+		b = t;
+	}
+
+	/* Make B the first child of A. */
+	b->prev = a;
+	b->next = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	a->child = b;
+	a->next = a->prev = NULL;
+	return a;
+}
+
+/* Melds the sibling list starting at FIRST into one tree, in the
+   standard two passes: pair up siblings left to right, then meld
+   the pairs right to left.  Returns its root. */
+static struct pheap_elem *
+merge_pairs (const struct pheap *h, struct pheap_elem *first) {
+	struct pheap_elem *pairs = NULL;
+	struct pheap_elem *root = NULL;
+
+	while (first != NULL) {
+		struct pheap_elem *a = first;
+		struct pheap_elem *b = a->next;
+		struct pheap_elem *m;
+
+		first = b != NULL ? b->next : NULL;
+		a->next = a->prev = NULL;
+		if (b != NULL)
+			b->next = b->prev = NULL;
+		m = meld (h, a, b);
+		m->next = pairs;
+		pairs = m;
+	}
+
+	while (pairs != NULL) {
+		struct pheap_elem *next = pairs->next;
+		pairs->next = NULL;
+		root = meld (h, root, pairs);
+		pairs = next;
+	}
+	return root;
+}
+
+/* Initializes H as an empty heap ordered by LESS, given
+   auxiliary data AUX. */
+void
+pheap_init (struct pheap *h, pheap_less_func *less, void *aux) {
+	ASSERT (h != NULL);
+	ASSERT (less != NULL);
+
+	h->root = NULL;
+	h->less = less;
+	h->aux = aux;
+	h->next_seq = 0;
+}
+
+/* Returns true if H is empty, false otherwise. */
+bool
+pheap_empty (const struct pheap *h) {
+	return h->root == NULL;
+}
+
+/* Returns the maximum element of H, which must not be empty. */
+struct pheap_elem *
+pheap_max (const struct pheap *h) {
+	ASSERT (!pheap_empty (h));
+	return h->root;
+}
+
+/* Inserts E into H. */
+void
+pheap_push (struct pheap *h, struct pheap_elem *e) {
+	ASSERT (e != NULL);
+
+	e->child = e->next = e->prev = NULL;
+	e->seq = h->next_seq++;
+	h->root = meld (h, h->root, e);
+}
+
+/* Removes the maximum element of H, which must not be empty, and
+   returns it. */
+struct pheap_elem *
+pheap_pop (struct pheap *h) {
+	struct pheap_elem *e = pheap_max (h);
+
+	h->root = merge_pairs (h, e->child);
+	e->child = NULL;
+	return e;
+}
+
+/* Removes E, which must be in H, from H. */
+void
+pheap_remove (struct pheap *h, struct pheap_elem *e) {
+	struct pheap_elem *sub;
+
+	ASSERT (e != NULL);
+
+	if (e == h->root) {
+		pheap_pop (h);
+		return;
+	}
+
+	/* Cut E's subtree out of its parent's child list. */
+	if (e->prev->child == e)
+		e->prev->child = e->next;
+	else
+		e->prev->next = e->next;
+	if (e->next != NULL)
+		e->next->prev = e->prev;
+	e->next = e->prev = NULL;
+
+	/* Meld E's children back in. */
+	sub = merge_pairs (h, e->child);
+	e->child = NULL;
+	h->root = meld (h, h->root, sub);
+}
+
+/* Restores the heap order of H after the key of E, which must be
+   in H, has changed in either direction.  E then ranks after
+   elements that compare equal to it, as if newly inserted. */
+void
+pheap_update (struct pheap *h, struct pheap_elem *e) {
+	pheap_remove (h, e);
+	pheap_push (h, e);
+}
@@ -0,0 +1,78 @@
+#include <synch.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <syscall.h>
+
+/* The mutex follows "mutex2" of Drepper, "Futexes Are Tricky". */
+
+/* Initializes mutex M as unlocked. */
+void
+mutex_init (struct mutex *m) {
+	m->state = 0;
+}
+
+/* Locks M, sleeping in the kernel while another thread holds
+   it.  Marks M as possibly having waiters whenever it has to
+   wait, so that the eventual unlock wakes someone. */
+void
+mutex_lock (struct mutex *m) {
+	int c = 0;
+
+	if (__atomic_compare_exchange_n (&m->state, &c, 1, false,
+				__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return;
+
+	if (c != 2)
+		c = __atomic_exchange_n (&m->state, 2, __ATOMIC_ACQUIRE);
+	while (c != 0) {
+		futex (&m->state, FUTEX_WAIT, 2);
+		c = __atomic_exchange_n (&m->state, 2, __ATOMIC_ACQUIRE);
+	}
+}
+
+/* Unlocks M, which the caller must hold, waking one waiter if
+   there might be any. */
+void
+mutex_unlock (struct mutex *m) {
+	if (__atomic_fetch_sub (&m->state, 1, __ATOMIC_RELEASE) != 1) {
+		__atomic_store_n (&m->state, 0, __ATOMIC_RELEASE);
+		futex (&m->state, FUTEX_WAKE, 1);
+	}
+}
+
+/* Initializes condition variable CV. */
+void
+condvar_init (struct condvar *cv) {
+	cv->seq = 0;
+}
+
+/* Atomically releases M and waits for CV to be signaled, then
+   reacquires M.  As with kernel condition variables, the caller
+   must recheck its condition after waking. */
+void
+condvar_wait (struct condvar *cv, struct mutex *m) {
+	int seq = __atomic_load_n (&cv->seq, __ATOMIC_RELAXED);
+	int c;
+
+	mutex_unlock (m);
+	futex (&cv->seq, FUTEX_WAIT, seq);
+
+	/* Other waiters may have been woken with us, so take M in the
+	   contended state to make sure they are woken in turn. */
+	while ((c = __atomic_exchange_n (&m->state, 2, __ATOMIC_ACQUIRE)) != 0)
+		futex (&m->state, FUTEX_WAIT, 2);
+}
+
+/* Wakes one thread waiting on CV, if any. */
+void
+condvar_signal (struct condvar *cv) {
+	__atomic_add_fetch (&cv->seq, 1, __ATOMIC_RELEASE);
+	futex (&cv->seq, FUTEX_WAKE, 1);
+}
+
+/* Wakes all threads waiting on CV. */
+void
+condvar_broadcast (struct condvar *cv) {
+	__atomic_add_fetch (&cv->seq, 1, __ATOMIC_RELEASE);
+	futex (&cv->seq, FUTEX_WAKE, INT_MAX);
+}
@@ -194,3 +194,18 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+int
+getrusage (int who, struct rusage *usage) {
+	return syscall2 (SYS_GETRUSAGE, who, usage);
+}
+
+int
+futex (int *addr, int op, int val) {
+	return syscall3 (SYS_FUTEX, addr, op, val);
+}
+
+bool
+group_new (unsigned weight) {
+	return syscall1 (SYS_GROUP_NEW, weight);
+}
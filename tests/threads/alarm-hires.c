@@ -0,0 +1,74 @@
+/* Benchmarks sub-tick sleeps.  Sleeps for a range of durations
+   shorter than a timer tick and reports how late the sleeper
+   woke up, on average and at worst, as well as how much CPU a
+   lower-priority thread got meanwhile, which is none if the
+   sleeps busy-wait.
+
+   This is a benchmark rather than a test: its output varies from
+   run to run, so it is not part of the graded test set.  Run it
+   with `pintos -- run alarm-hires'. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "devices/hrtimer.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+/* Rounds per duration. */
+#define ROUNDS 20
+
+static volatile bool done;
+static volatile uint64_t spins;
+
+static void
+spinner (void *aux UNUSED) 
+{
+  while (!done)
+    spins++;
+}
+
+void
+test_alarm_hires (void) 
+{
+  static const int64_t durations[] = {20, 100, 500, 1000, 5000};
+  uint64_t hz;
+  size_t i;
+
+  msg ("%s", hrtimer_available () ? "local APIC timer" : "busy-wait");
+  thread_create ("spinner", PRI_DEFAULT - 1, spinner, NULL);
+
+  /* Let the TSC frequency estimate settle. */
+  timer_msleep (100);
+  hz = timer_tsc_hz ();
+
+  for (i = 0; i < sizeof durations / sizeof *durations; i++) 
+    {
+      int64_t us = durations[i];
+      uint64_t total = 0, worst = 0, spins_before = spins;
+      int round;
+
+      for (round = 0; round < ROUNDS; round++) 
+        {
+          uint64_t start = rdtsc ();
+          uint64_t elapsed_ns, late_ns;
+
+          timer_usleep (us);
+          elapsed_ns = (rdtsc () - start) * 1000000 / (hz / 1000);
+          late_ns = elapsed_ns > (uint64_t) us * 1000
+                    ? elapsed_ns - us * 1000 : 0;
+          total += late_ns;
+          if (late_ns > worst)
+            worst = late_ns;
+        }
+      msg ("%5"PRId64" us: mean error %"PRIu64" ns, max %"PRIu64" ns, "
+           "%"PRIu64" background spins",
+           us, total / ROUNDS, worst, spins - spins_before);
+    }
+
+  done = true;
+  timer_msleep (10);
+  pass ();
+}
@@ -0,0 +1,94 @@
+/* Checks that a sleeper armed on an upper level of the sleep
+   wheel wakes on time when a later level-0 sleeper is armed in
+   the slot just behind the current one, that is, in the next
+   lap of level 0.  The wheel must still be serviced at the lap
+   boundary to cascade the upper level.
+
+   The main thread waits for the start of a lap, then threads D,
+   C and B go to sleep for 29, 40 and 70 ticks.  B's wake time is
+   a lap away, so it lands on level 1.  At tick 30 the main
+   thread goes to sleep until tick 90, which lands on level 0 in
+   the slot before the current one.  B must wake at tick 70, not
+   along with the main thread at tick 90. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Ticks in a lap of level 0 of the sleep wheel. */
+#define LAP 64
+
+/* Most ticks a sleeper may wake late. */
+#define SLACK 5
+
+struct sleeper
+  {
+    const char *name;           /* Thread name. */
+    int64_t wake_time;          /* Tick to wake at. */
+    int64_t woke;               /* Tick actually woken at. */
+  };
+
+static int64_t base;
+static struct semaphore done;
+
+static thread_func sleeper_thread;
+
+void
+test_alarm_wheel_lap (void)
+{
+  static struct sleeper sleepers[] =
+    {
+      {"D", 29, 0},
+      {"C", 40, 0},
+      {"B", 70, 0},
+    };
+  const size_t cnt = sizeof sleepers / sizeof *sleepers;
+  int64_t now;
+  size_t i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+
+  /* Start at a lap boundary. */
+  now = timer_ticks ();
+  base = (now / LAP + 1) * LAP;
+  timer_sleep (base - now);
+  if (timer_ticks () != base)
+    msg ("warning: started at tick %lld, not %lld",
+         (long long) timer_ticks (), (long long) base);
+
+  for (i = 0; i < cnt; i++)
+    thread_create (sleepers[i].name, PRI_DEFAULT + 1, sleeper_thread,
+                   &sleepers[i]);
+
+  timer_sleep (base + 30 - timer_ticks ());
+  timer_sleep (base + 90 - timer_ticks ());
+  msg ("Thread main woke up.");
+
+  for (i = 0; i < cnt; i++)
+    sema_down (&done);
+  for (i = 0; i < cnt; i++)
+    {
+      int64_t late = sleepers[i].woke - (base + sleepers[i].wake_time);
+      if (late < 0 || late > SLACK)
+        fail ("thread %s woke %lld ticks after its wake time",
+              sleepers[i].name, (long long) late);
+    }
+  msg ("All threads woke on time.");
+}
+
+static void
+sleeper_thread (void *s_)
+{
+  struct sleeper *s = s_;
+
+  timer_sleep (base + s->wake_time - timer_ticks ());
+  s->woke = timer_ticks ();
+  msg ("Thread %s woke up.", s->name);
+  sema_up (&done);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-wheel-lap) begin
+(alarm-wheel-lap) Thread D woke up.
+(alarm-wheel-lap) Thread C woke up.
+(alarm-wheel-lap) Thread B woke up.
+(alarm-wheel-lap) Thread main woke up.
+(alarm-wheel-lap) All threads woke on time.
+(alarm-wheel-lap) end
+EOF
+pass;
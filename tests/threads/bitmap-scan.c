@@ -0,0 +1,112 @@
+/* Benchmarks bitmap_scan() and bitmap_count() on a bitmap that is
+   90% set, such as a nearly full free map, against the bit-at-a-
+   time algorithms they replaced, and checks that both agree.
+
+   This is a benchmark rather than a test: its output varies from
+   run to run, so it is not part of the graded test set.  Run it
+   with `pintos -- run bitmap-scan'. */
+
+#include <bitmap.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "intrinsic.h"
+
+/* Bits in the bitmap. */
+#define BIT_CNT 65536
+
+/* Scans per group size. */
+#define ROUNDS 16
+
+/* Finds a group of CNT bits set to false in B at or after START,
+   testing every candidate bit by bit, as bitmap_scan() used to. */
+static size_t
+old_scan (const struct bitmap *b, size_t start, size_t cnt)
+{
+  size_t i, j;
+
+  for (i = start; i + cnt <= bitmap_size (b); i++)
+    {
+      for (j = 0; j < cnt; j++)
+        if (bitmap_test (b, i + j))
+          break;
+      if (j == cnt)
+        return i;
+    }
+  return BITMAP_ERROR;
+}
+
+/* Counts the bits set to true in B bit by bit, as bitmap_count()
+   used to. */
+static size_t
+old_count (const struct bitmap *b)
+{
+  size_t i, cnt = 0;
+
+  for (i = 0; i < bitmap_size (b); i++)
+    if (bitmap_test (b, i))
+      cnt++;
+  return cnt;
+}
+
+void
+test_bitmap_scan (void)
+{
+  static const size_t cnts[] = {1, 2, 4, 8};
+  struct bitmap *b;
+  uint64_t start, old_cycles, new_cycles;
+  size_t i, old_result, new_result;
+
+  b = bitmap_create (BIT_CNT);
+  if (b == NULL)
+    fail ("out of memory");
+
+  /* Free a random 10% of the bits. */
+  random_init (0);
+  bitmap_set_all (b, true);
+  for (i = 0; i < BIT_CNT / 10; i++)
+    bitmap_reset (b, random_ulong () % BIT_CNT);
+
+  for (i = 0; i < sizeof cnts / sizeof *cnts; i++)
+    {
+      size_t cnt = cnts[i];
+      size_t pos = 0;
+      int rounds;
+
+      old_cycles = new_cycles = 0;
+      for (rounds = 1; rounds <= ROUNDS; rounds++)
+        {
+          start = rdtsc ();
+          old_result = old_scan (b, pos, cnt);
+          old_cycles += rdtsc () - start;
+
+          start = rdtsc ();
+          new_result = bitmap_scan (b, pos, cnt, false);
+          new_cycles += rdtsc () - start;
+
+          if (old_result != new_result)
+            fail ("scan for %zu bits from %zu: old %zu, new %zu",
+                  cnt, pos, old_result, new_result);
+          if (new_result == BITMAP_ERROR || rounds == ROUNDS)
+            break;
+          pos = new_result + 1;
+        }
+      msg ("scan %zu: old %"PRIu64" cycles, new %"PRIu64" cycles",
+           cnt, old_cycles / rounds, new_cycles / rounds);
+    }
+
+  start = rdtsc ();
+  old_result = old_count (b);
+  old_cycles = rdtsc () - start;
+  start = rdtsc ();
+  new_result = bitmap_count (b, 0, BIT_CNT, true);
+  new_cycles = rdtsc () - start;
+  if (old_result != new_result)
+    fail ("count: old %zu, new %zu", old_result, new_result);
+  msg ("count: old %"PRIu64" cycles, new %"PRIu64" cycles",
+       old_cycles, new_cycles);
+
+  bitmap_destroy (b);
+  pass ();
+}
@@ -0,0 +1,72 @@
+/* Checks admission control of the earliest-deadline-first class.
+
+   Threads may move into the EDF class only while the utilization
+   runtime / period summed over all EDF threads stays at or below
+   95%.  The main thread and a series of child threads ask for
+   various shares of the CPU and report whether they got them. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Period that every request is made for, in ticks. */
+#define PERIOD 100
+
+static struct semaphore done;
+
+static thread_func child_thread;
+static bool ask (int runtime);
+static void ask_in_child (int runtime);
+
+void
+test_edf_admission (void)
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+
+  ask (96);
+  ask (95);
+  ask_in_child (1);
+  ask (50);
+  ask_in_child (46);
+  ask_in_child (45);
+  ask (0);
+  ask_in_child (95);
+}
+
+/* Asks for RUNTIME ticks of every PERIOD for the running thread,
+   reports the outcome, and returns true if it was admitted. */
+static bool
+ask (int runtime)
+{
+  bool admitted = thread_set_deadline (runtime, PERIOD, PERIOD);
+
+  msg ("Thread %s asks for %d/%d: %s.", thread_name (), runtime, PERIOD,
+       admitted ? "admitted" : "rejected");
+  return admitted;
+}
+
+/* Has a child thread ask for RUNTIME ticks of every PERIOD, and
+   waits for it to be done. */
+static void
+ask_in_child (int runtime)
+{
+  thread_create ("child", PRI_DEFAULT, child_thread, &runtime);
+  sema_down (&done);
+}
+
+static void
+child_thread (void *runtime_)
+{
+  int *runtime = runtime_;
+
+  /* Leave the EDF class again before waking up the main thread,
+     so that the next request sees only the main thread's share. */
+  if (ask (*runtime))
+    thread_set_deadline (0, 0, 0);
+  sema_up (&done);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-admission) begin
+(edf-admission) Thread main asks for 96/100: rejected.
+(edf-admission) Thread main asks for 95/100: admitted.
+(edf-admission) Thread child asks for 1/100: rejected.
+(edf-admission) Thread main asks for 50/100: admitted.
+(edf-admission) Thread child asks for 46/100: rejected.
+(edf-admission) Thread child asks for 45/100: admitted.
+(edf-admission) Thread main asks for 0/100: admitted.
+(edf-admission) Thread child asks for 95/100: admitted.
+(edf-admission) end
+EOF
+pass;
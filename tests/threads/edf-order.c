@@ -0,0 +1,52 @@
+/* Checks that among ready EDF threads the one with the earliest
+   deadline runs first.
+
+   Threads "late" and "early" move into the EDF class, in that
+   order, with relative deadlines of 50 and 20 ticks, and then
+   sleep until the same tick.  Once both are woken, "early"
+   should run first, even though it was created second. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* EDF parameters shared by both threads, in ticks. */
+#define RUNTIME 5
+#define PERIOD 100
+
+static int64_t wake_time;
+static struct semaphore done;
+
+static thread_func edf_thread;
+
+void
+test_edf_order (void)
+{
+  int late_deadline = 50;
+  int early_deadline = 20;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  wake_time = timer_ticks () + 10;
+  thread_create ("late", PRI_DEFAULT + 1, edf_thread, &late_deadline);
+  thread_create ("early", PRI_DEFAULT + 1, edf_thread, &early_deadline);
+  sema_down (&done);
+  sema_down (&done);
+}
+
+static void
+edf_thread (void *deadline_)
+{
+  int *deadline = deadline_;
+
+  if (!thread_set_deadline (RUNTIME, *deadline, PERIOD))
+    fail ("Thread %s was not admitted.", thread_name ());
+  timer_sleep_until (wake_time);
+  msg ("Thread %s woke up.", thread_name ());
+  sema_up (&done);
+}
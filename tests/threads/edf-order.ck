@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-order) begin
+(edf-order) Thread early woke up.
+(edf-order) Thread late woke up.
+(edf-order) end
+EOF
+pass;
@@ -0,0 +1,57 @@
+/* Checks that an EDF thread that spends its budget is throttled
+   for the rest of its period, letting lower threads run.
+
+   Thread E moves into the EDF class with a budget of RUNTIME
+   ticks every PERIOD ticks and then spins for longer than its
+   budget.  It should be throttled partway through, so that the
+   main thread, of the priority class, gets to run and print its
+   message, and should not run again until its next period. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* EDF parameters of thread E, in ticks. */
+#define RUNTIME 3
+#define PERIOD 20
+
+static struct semaphore done;
+
+static thread_func edf_thread;
+
+void
+test_edf_throttle (void)
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  thread_create ("E", PRI_DEFAULT + 1, edf_thread, NULL);
+  msg ("Main thread runs while thread E is throttled.");
+  sema_down (&done);
+}
+
+static void
+edf_thread (void *aux UNUSED)
+{
+  /* Taken before the period starts, so START + PERIOD is no later
+     than the start of the next period. */
+  int64_t start = timer_ticks ();
+
+  if (!thread_set_deadline (RUNTIME, PERIOD, PERIOD))
+    fail ("Thread E was not admitted.");
+
+  /* Print nothing until throttled, to keep the console lock free
+     for the main thread. */
+  while (timer_elapsed (start) < 2 * RUNTIME)
+    continue;
+  if (timer_elapsed (start) < PERIOD)
+    fail ("Thread E ran %"PRId64" ticks into a period of %d.",
+          timer_elapsed (start), PERIOD);
+  msg ("Thread E resumed in its next period.");
+  sema_up (&done);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-throttle) begin
+(edf-throttle) Main thread runs while thread E is throttled.
+(edf-throttle) Thread E resumed in its next period.
+(edf-throttle) end
+EOF
+pass;
@@ -0,0 +1,75 @@
+/* Checks that scheduling groups share the CPU in proportion to
+   their weights.
+
+   Threads L and H each move into a scheduling group of their
+   own, of weight 1024 and 2048 respectively, and then spin side
+   by side for 10 seconds, counting the timer ticks they see
+   while running.  H's group should get about twice the CPU time
+   of L's, that is, about 667 and 333 of the 1000 ticks. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Ticks to let the threads spin for. */
+#define SPIN_TIME (10 * TIMER_FREQ)
+
+struct spinner
+  {
+    unsigned weight;            /* Weight of the thread's group. */
+    int tick_count;             /* Ticks seen while running. */
+  };
+
+static int64_t start_time;
+static struct semaphore done;
+
+static thread_func spinner_thread;
+
+void
+test_group_share (void)
+{
+  struct spinner l = {GROUP_WEIGHT_DEFAULT, 0};
+  struct spinner h = {2 * GROUP_WEIGHT_DEFAULT, 0};
+  int ratio;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  start_time = timer_ticks () + TIMER_FREQ;
+  thread_create ("L", PRI_DEFAULT, spinner_thread, &l);
+  thread_create ("H", PRI_DEFAULT, spinner_thread, &h);
+  sema_down (&done);
+  sema_down (&done);
+
+  /* H's share, in hundredths of L's. */
+  ratio = h.tick_count * 100 / (l.tick_count > 0 ? l.tick_count : 1);
+  if (ratio < 160 || ratio > 240)
+    fail ("H got %d ticks and L got %d; expected about twice as many.",
+          h.tick_count, l.tick_count);
+  msg ("Groups shared the CPU in proportion to their weights.");
+}
+
+static void
+spinner_thread (void *s_)
+{
+  struct spinner *s = s_;
+  int64_t last_time = 0;
+
+  if (!thread_group_new (s->weight))
+    fail ("Out of memory creating a scheduling group.");
+
+  /* Start spinning together. */
+  timer_sleep (start_time - timer_ticks ());
+  while (timer_elapsed (start_time) < SPIN_TIME)
+    {
+      int64_t cur_time = timer_ticks ();
+      if (cur_time != last_time)
+        s->tick_count++;
+      last_time = cur_time;
+    }
+  sema_up (&done);
+}
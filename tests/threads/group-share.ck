@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(group-share) begin
+(group-share) Groups shared the CPU in proportion to their weights.
+(group-share) end
+EOF
+pass;
@@ -0,0 +1,132 @@
+/* Maps a 2 MB huge page in a scratch page map, splits it into
+   4 kB pages, promotes it back to a huge page, and destroys the
+   page map, checking the translation at each step, both through
+   the page map and through the CPU.  Also checks that
+   pml4_for_each() shows each 4 kB page of the huge page. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Number of 4 kB pages in a huge page. */
+#define HUGE_PAGE_CNT (PDE_PGSIZE / PGSIZE)
+
+/* User virtual address to map the huge page at. */
+#define UPAGE ((uint8_t *) 0x40000000)
+
+static uint8_t *kpage;
+
+static void check_mapping (uint64_t *pml4, uint64_t size);
+static void check_access (uint64_t *pml4, size_t page);
+static pte_for_each_func count_user_page;
+
+void
+test_mmu_huge (void)
+{
+  uint64_t *pml4;
+  size_t cnt;
+
+  pml4 = pml4_create ();
+  kpage = palloc_get_multiple (PAL_USER | PAL_ZERO, HUGE_PAGE_CNT);
+  if (pml4 == NULL || kpage == NULL)
+    fail ("Out of memory.");
+  if ((uint64_t) kpage % PDE_PGSIZE != 0)
+    fail ("palloc_get_multiple() returned %p, not aligned to 2 MB.", kpage);
+
+  msg ("Map a huge page.");
+  if (!pml4_set_huge_page (pml4, UPAGE, kpage, true))
+    fail ("pml4_set_huge_page() failed.");
+  check_mapping (pml4, PDE_PGSIZE);
+  check_access (pml4, 0);
+  check_access (pml4, HUGE_PAGE_CNT - 1);
+
+  cnt = 0;
+  pml4_for_each (pml4, count_user_page, &cnt);
+  if (cnt != HUGE_PAGE_CNT)
+    fail ("pml4_for_each() showed %zu user pages, not %zu.",
+          cnt, HUGE_PAGE_CNT);
+
+  msg ("Split it.");
+  if (!pml4_split_huge_page (pml4, UPAGE))
+    fail ("pml4_split_huge_page() failed.");
+  check_mapping (pml4, PGSIZE);
+  check_access (pml4, 1);
+
+  msg ("Promote it with a page missing.");
+  pml4_clear_page (pml4, UPAGE + 7 * PGSIZE);
+  if (pml4_promote_huge_page (pml4, UPAGE))
+    fail ("Promoted a huge page with a page not present.");
+
+  msg ("Promote it with all pages present.");
+  if (!pml4_set_page (pml4, UPAGE + 7 * PGSIZE, kpage + 7 * PGSIZE, true))
+    fail ("pml4_set_page() failed.");
+  if (!pml4_promote_huge_page (pml4, UPAGE))
+    fail ("pml4_promote_huge_page() failed.");
+  check_mapping (pml4, PDE_PGSIZE);
+  check_access (pml4, 7);
+
+  msg ("Destroy the page map.");
+  pml4_destroy (pml4);
+}
+
+/* Checks that every page of UPAGE maps the corresponding page
+   of KPAGE in PML4, through an entry that maps SIZE bytes. */
+static void
+check_mapping (uint64_t *pml4, uint64_t size)
+{
+  size_t i;
+
+  for (i = 0; i < HUGE_PAGE_CNT; i++)
+    {
+      uint8_t *upage = UPAGE + i * PGSIZE;
+      uint64_t entry_size;
+
+      if (pml4e_lookup (pml4, (uint64_t) upage, &entry_size) == NULL
+          || entry_size != size)
+        fail ("%p is not mapped by an entry of %llu bytes.",
+              upage, (unsigned long long) size);
+      if (pml4_get_page (pml4, upage + 5) != kpage + i * PGSIZE + 5)
+        fail ("%p does not map %p.", upage, kpage + i * PGSIZE);
+    }
+}
+
+/* Writes to page PAGE of UPAGE with PML4 active and checks that
+   the write lands in the same page of KPAGE. */
+static void
+check_access (uint64_t *pml4, size_t page)
+{
+  uint64_t *uaddr = (uint64_t *) (UPAGE + page * PGSIZE);
+  uint64_t *kaddr = (uint64_t *) (kpage + page * PGSIZE);
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  pml4_activate (pml4);
+  *uaddr = 0x1234567800000000ULL | page;
+  pml4_activate (NULL);
+  intr_set_level (old_level);
+
+  if (*kaddr != (0x1234567800000000ULL | page))
+    fail ("Write to %p did not reach %p.", uaddr, kaddr);
+}
+
+/* Counts, in *CNT_, the user pages pml4_for_each() shows, and
+   checks that each is a 4 kB page of KPAGE. */
+static bool
+count_user_page (uint64_t *pte, void *va, void *cnt_)
+{
+  size_t *cnt = cnt_;
+  uint8_t *upage = va;
+
+  if (!is_user_pte (pte))
+    return true;
+  if ((*pte & PTE_PS) || (upage - UPAGE) % PGSIZE != 0
+      || ptov (PTE_ADDR (*pte)) != kpage + (upage - UPAGE))
+    fail ("pml4_for_each() showed %p as %#llx.",
+          upage, (unsigned long long) *pte);
+  (*cnt)++;
+  return true;
+}
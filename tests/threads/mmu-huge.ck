@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mmu-huge) begin
+(mmu-huge) Map a huge page.
+(mmu-huge) Split it.
+(mmu-huge) Promote it with a page missing.
+(mmu-huge) Promote it with all pages present.
+(mmu-huge) Destroy the page map.
+(mmu-huge) end
+EOF
+pass;
@@ -0,0 +1,133 @@
+/* Checks the buddy allocator behind palloc_get_multiple() and
+   palloc_free_multiple().
+
+   The test first takes every page of the user pool, and then
+   frees a single 4 MB block, so that the block is all the pool
+   has left and the allocator's choices can be predicted.  Within
+   it, a 3-page request splits the block and gives its 4th page
+   back, the blocks split off are handed out in address order,
+   and once everything is freed the halves coalesce into the
+   4 MB block again.  Power-of-2 requests must be aligned to
+   their size, which the slab allocator relies on, and requests
+   for more than 1024 pages must fail.
+
+   Printing may block, letting the idle thread take a page of the
+   free block to pre-zero it, so nothing is printed until the
+   pool is given back. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Pages in the largest block. */
+#define MAX_BLOCK 1024
+
+/* Header of a block held while the pool is drained. */
+struct held
+  {
+    struct held *next;          /* Next held block. */
+    size_t page_cnt;            /* Pages in this block. */
+  };
+
+static struct held *drain_user_pool (void);
+static void *get (size_t page_cnt);
+static void expect (const char *what, void *got, void *want);
+
+void
+test_palloc_buddy (void)
+{
+  struct held *held, *h;
+  uint8_t *b, *p3, *p1, *p2, *p8;
+  size_t n;
+
+  /* Take the whole user pool, then free one 4 MB block. */
+  held = drain_user_pool ();
+  if (held == NULL || held->page_cnt != MAX_BLOCK)
+    fail ("User pool has no 4 MB block.");
+  b = (uint8_t *) held;
+  held = held->next;
+  palloc_free_multiple (b, MAX_BLOCK);
+
+  p3 = get (3);
+  expect ("3 pages", p3, b);
+  p1 = get (1);
+  expect ("1 page after the 3", p1, b + 3 * PGSIZE);
+  p2 = get (2);
+  expect ("2 pages", p2, b + 4 * PGSIZE);
+  p8 = get (8);
+  expect ("8 pages", p8, b + 8 * PGSIZE);
+  if (palloc_get_multiple (PAL_USER, MAX_BLOCK) != NULL)
+    fail ("Got 4 MB while part of the only 4 MB block is in use.");
+
+  palloc_free_multiple (p3, 3);
+  palloc_free_multiple (p1, 1);
+  palloc_free_multiple (p2, 2);
+  palloc_free_multiple (p8, 8);
+  expect ("4 MB", get (MAX_BLOCK), b);
+  palloc_free_multiple (b, MAX_BLOCK);
+
+  /* Give the pool back. */
+  while (held != NULL)
+    {
+      h = held;
+      held = h->next;
+      palloc_free_multiple (h, h->page_cnt);
+    }
+  msg ("Split a 4 MB block and coalesced it again.");
+
+  msg ("Check alignment.");
+  for (n = 1; n <= MAX_BLOCK; n *= 2)
+    {
+      uint8_t *p = get (n);
+      if (vtop (p) % (n * PGSIZE) != 0)
+        fail ("%zu pages at %p are not aligned to their size.", n, p);
+      palloc_free_multiple (p, n);
+    }
+
+  msg ("Ask for more than 4 MB.");
+  if (palloc_get_multiple (PAL_USER, MAX_BLOCK + 1) != NULL)
+    fail ("Got %d pages.", MAX_BLOCK + 1);
+}
+
+/* Allocates every page of the user pool, largest blocks first,
+   and returns them as a list, largest first. */
+static struct held *
+drain_user_pool (void)
+{
+  struct held *held = NULL, **tail = &held;
+  size_t n;
+
+  for (n = MAX_BLOCK; n >= 1; n /= 2)
+    {
+      struct held *h;
+
+      while ((h = palloc_get_multiple (PAL_USER, n)) != NULL)
+        {
+          h->next = NULL;
+          h->page_cnt = n;
+          *tail = h;
+          tail = &h->next;
+        }
+    }
+  return held;
+}
+
+/* Allocates PAGE_CNT pages from the user pool, failing the test
+   if there are not enough. */
+static void *
+get (size_t page_cnt)
+{
+  void *p = palloc_get_multiple (PAL_USER, page_cnt);
+  if (p == NULL)
+    fail ("Could not get %zu pages.", page_cnt);
+  return p;
+}
+
+/* Fails the test if WHAT was allocated at GOT rather than WANT. */
+static void
+expect (const char *what, void *got, void *want)
+{
+  if (got != want)
+    fail ("%s at %p, expected %p.", what, got, want);
+}
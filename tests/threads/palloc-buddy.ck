@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-buddy) begin
+(palloc-buddy) Split a 4 MB block and coalesced it again.
+(palloc-buddy) Check alignment.
+(palloc-buddy) Ask for more than 4 MB.
+(palloc-buddy) end
+EOF
+pass;
@@ -0,0 +1,68 @@
+/* Checks that releasing a reader-writer lock held for writing
+   hands it to all the waiting readers at once, and that a
+   writer then waits for every one of them.
+
+   The main thread holds the lock for writing while three
+   readers of higher priority queue for it.  When it lets go,
+   each reader must get the lock while the others still hold it.
+   The readers then wait to be told to release it, and the main
+   thread's next write acquisition must wait until they all
+   have. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define READER_CNT 3
+
+static thread_func reader_thread;
+static struct rwlock rw;
+static struct semaphore go;
+
+void
+test_rwlock_readers (void)
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  sema_init (&go, 0);
+  rwlock_write_acquire (&rw);
+  msg ("Main thread holds the lock for writing.");
+  for (i = 0; i < READER_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "reader %d", i);
+      thread_create (name, PRI_DEFAULT + 1, reader_thread, NULL);
+    }
+  msg ("Main thread releasing the lock.");
+  rwlock_write_release (&rw);
+
+  /* Let the readers run.  Each blocks on GO, holding the lock. */
+  thread_set_priority (PRI_MIN);
+  msg ("%d readers hold the lock.", rw.readers);
+
+  for (i = 0; i < READER_CNT; i++)
+    sema_up (&go);
+  rwlock_write_acquire (&rw);
+  msg ("Main thread got the lock for writing.");
+  rwlock_write_release (&rw);
+}
+
+static void
+reader_thread (void *aux UNUSED)
+{
+  msg ("Thread %s waiting for the lock.", thread_name ());
+  rwlock_read_acquire (&rw);
+  msg ("Thread %s got the lock.", thread_name ());
+  sema_down (&go);
+  msg ("Thread %s releasing the lock.", thread_name ());
+  rwlock_read_release (&rw);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-readers) begin
+(rwlock-readers) Main thread holds the lock for writing.
+(rwlock-readers) Thread reader 0 waiting for the lock.
+(rwlock-readers) Thread reader 1 waiting for the lock.
+(rwlock-readers) Thread reader 2 waiting for the lock.
+(rwlock-readers) Main thread releasing the lock.
+(rwlock-readers) Thread reader 0 got the lock.
+(rwlock-readers) Thread reader 1 got the lock.
+(rwlock-readers) Thread reader 2 got the lock.
+(rwlock-readers) 3 readers hold the lock.
+(rwlock-readers) Thread reader 0 releasing the lock.
+(rwlock-readers) Thread reader 1 releasing the lock.
+(rwlock-readers) Thread reader 2 releasing the lock.
+(rwlock-readers) Main thread got the lock for writing.
+(rwlock-readers) end
+EOF
+pass;
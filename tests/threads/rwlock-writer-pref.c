@@ -0,0 +1,57 @@
+/* Checks that a reader-writer lock prefers writers: once a
+   writer waits for the lock, a reader that arrives later waits
+   behind it even though the lock is only held for reading.
+
+   The main thread holds the lock for reading while a writer and
+   then a reader, both of higher priority, try to acquire it.  The
+   reader must not get the lock until the writer has had it. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread;
+static thread_func reader_thread;
+static struct rwlock rw;
+
+void
+test_rwlock_writer_pref (void)
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_read_acquire (&rw);
+  msg ("Main thread holds the lock for reading.");
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread, NULL);
+  thread_create ("reader", PRI_DEFAULT + 1, reader_thread, NULL);
+  msg ("Main thread releasing the lock.");
+  rwlock_read_release (&rw);
+
+  /* Let the writer and then the reader run. */
+  thread_set_priority (PRI_MIN);
+  msg ("Main thread done.");
+}
+
+static void
+writer_thread (void *aux UNUSED)
+{
+  msg ("Writer waiting for the lock.");
+  rwlock_write_acquire (&rw);
+  msg ("Writer got the lock.");
+  rwlock_write_release (&rw);
+}
+
+static void
+reader_thread (void *aux UNUSED)
+{
+  msg ("Reader waiting for the lock.");
+  rwlock_read_acquire (&rw);
+  msg ("Reader got the lock.");
+  rwlock_read_release (&rw);
+}
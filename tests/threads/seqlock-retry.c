@@ -0,0 +1,63 @@
+/* Checks that a sequence lock reader retries when a write
+   happens in the middle of its read, and only then.
+
+   The main thread starts reading a two-field record, and a
+   writer of higher priority preempts it halfway through to
+   update both fields.  The main thread's read must be retried,
+   and the retry, which no write interrupts, must see the record
+   as the writer left it. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* A record that must be read as a whole. */
+struct record
+  {
+    int a, b;
+  };
+
+static thread_func writer_thread;
+static struct seqlock sl;
+static struct record rec;
+
+void
+test_seqlock_retry (void)
+{
+  struct record copy;
+  unsigned seq;
+  int tries = 0;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  seqlock_init (&sl);
+  do
+    {
+      seq = seqlock_read_begin (&sl);
+      copy.a = rec.a;
+      if (tries++ == 0)
+        thread_create ("writer", PRI_DEFAULT + 1, writer_thread, NULL);
+      copy.b = rec.b;
+      if (tries == 1 && seqlock_read_retry (&sl, seq))
+        msg ("Read saw {%d, %d}, interrupted by a write; retrying.",
+             copy.a, copy.b);
+    }
+  while (seqlock_read_retry (&sl, seq));
+  msg ("Read saw {%d, %d} after %d tries.", copy.a, copy.b, tries);
+}
+
+static void
+writer_thread (void *aux UNUSED)
+{
+  enum intr_level old_level = seqlock_write_begin (&sl);
+  rec.a = 1;
+  rec.b = 1;
+  seqlock_write_end (&sl, old_level);
+  msg ("Writer updated the record.");
+}
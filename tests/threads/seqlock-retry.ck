@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(seqlock-retry) begin
+(seqlock-retry) Writer updated the record.
+(seqlock-retry) Read saw {0, 1}, interrupted by a write; retrying.
+(seqlock-retry) Read saw {1, 1} after 2 tries.
+(seqlock-retry) end
+EOF
+pass;
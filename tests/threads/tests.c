@@ -17,6 +17,14 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-hires", test_alarm_hires},
+    {"alarm-wheel-lap", test_alarm_wheel_lap},
+    {"bitmap-scan", test_bitmap_scan},
+    {"mmu-huge", test_mmu_huge},
+    {"palloc-buddy", test_palloc_buddy},
+    {"rwlock-writer-pref", test_rwlock_writer_pref},
+    {"rwlock-readers", test_rwlock_readers},
+    {"seqlock-retry", test_seqlock_retry},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -29,6 +37,10 @@ static const struct test tests[] =
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"group-share", test_group_share},
+    {"edf-admission", test_edf_admission},
+    {"edf-throttle", test_edf_throttle},
+    {"edf-order", test_edf_order},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
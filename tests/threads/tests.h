@@ -11,6 +11,14 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_hires;
+extern test_func test_alarm_wheel_lap;
+extern test_func test_bitmap_scan;
+extern test_func test_mmu_huge;
+extern test_func test_palloc_buddy;
+extern test_func test_rwlock_writer_pref;
+extern test_func test_rwlock_readers;
+extern test_func test_seqlock_retry;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -23,6 +31,10 @@ extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_group_share;
+extern test_func test_edf_admission;
+extern test_func test_edf_throttle;
+extern test_func test_edf_order;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -0,0 +1,24 @@
+/* Calls futex(FUTEX_WAIT) with a value other than the one in the
+   futex word, which must return -1 at once instead of sleeping,
+   and then with bad arguments, which must also return -1. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int word = 5;
+
+void
+test_main (void)
+{
+  char buf[2 * sizeof (int)];
+
+  CHECK (futex (&word, FUTEX_WAIT, 6) == -1,
+         "wait for 6 when the word is 5");
+  CHECK (futex (NULL, FUTEX_WAIT, 0) == -1, "wait on a null pointer");
+  CHECK (futex ((int *) (buf + 1), FUTEX_WAIT, 0) == -1,
+         "wait on a misaligned word");
+  CHECK (futex ((int *) 0x8004000000, FUTEX_WAKE, 1) == -1,
+         "wake on a kernel address");
+  CHECK (futex (&word, 42, 0) == -1, "bad operation");
+}
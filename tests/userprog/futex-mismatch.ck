@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-mismatch) begin
+(futex-mismatch) wait for 6 when the word is 5
+(futex-mismatch) wait on a null pointer
+(futex-mismatch) wait on a misaligned word
+(futex-mismatch) wake on a kernel address
+(futex-mismatch) bad operation
+(futex-mismatch) end
+futex-mismatch: exit(0)
+EOF
+pass;
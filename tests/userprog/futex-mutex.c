@@ -0,0 +1,30 @@
+/* Locks and unlocks a user-level mutex, both uncontended, which
+   takes no system call, and marked as contended, as a thread
+   that had to wait for it leaves it, in which case unlocking
+   must issue FUTEX_WAKE and leave the mutex free. */
+
+#include <synch.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static struct mutex m = MUTEX_INITIALIZER;
+
+void
+test_main (void)
+{
+  mutex_lock (&m);
+  CHECK (m.state == 1, "lock the mutex");
+  mutex_unlock (&m);
+  CHECK (m.state == 0, "unlock the mutex");
+
+  mutex_lock (&m);
+  m.state = 2;
+  msg ("mark the mutex contended");
+  mutex_unlock (&m);
+  CHECK (m.state == 0, "unlock the contended mutex");
+
+  mutex_lock (&m);
+  CHECK (m.state == 1, "lock the mutex again");
+  mutex_unlock (&m);
+}
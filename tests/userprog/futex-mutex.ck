@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-mutex) begin
+(futex-mutex) lock the mutex
+(futex-mutex) unlock the mutex
+(futex-mutex) mark the mutex contended
+(futex-mutex) unlock the contended mutex
+(futex-mutex) lock the mutex again
+(futex-mutex) end
+futex-mutex: exit(0)
+EOF
+pass;
@@ -0,0 +1,21 @@
+/* Calls futex(FUTEX_WAKE) on words nobody waits on, which must
+   wake no one, including after a failed FUTEX_WAIT on the same
+   word left no waiter behind. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int word;
+
+void
+test_main (void)
+{
+  int local = 0;
+
+  CHECK (futex (&word, FUTEX_WAKE, 1) == 0, "wake one on a global word");
+  CHECK (futex (&local, FUTEX_WAKE, 100) == 0,
+         "wake many on a stack word");
+  CHECK (futex (&word, FUTEX_WAIT, 1) == -1, "wait with a stale value");
+  CHECK (futex (&word, FUTEX_WAKE, 1) == 0, "wake one again");
+}
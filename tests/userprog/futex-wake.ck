@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-wake) begin
+(futex-wake) wake one on a global word
+(futex-wake) wake many on a stack word
+(futex-wake) wait with a stale value
+(futex-wake) wake one again
+(futex-wake) end
+futex-wake: exit(0)
+EOF
+pass;
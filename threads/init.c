@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "devices/hrtimer.h"
 #include "devices/kbd.h"
 #include "devices/input.h"
 #include "devices/serial.h"
@@ -20,7 +21,11 @@
 #include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
+#include "threads/softirq.h"
 #include "threads/thread.h"
+#include "threads/lockstat.h"
+#include "threads/trace.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -37,6 +42,7 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#include "intrinsic.h"
 
 /* Page-map-level-4 with kernel mappings only. */
 uint64_t *base_pml4;
@@ -49,10 +55,14 @@ static bool format_filesys;
 /* -q: Power off after kernel tasks complete? */
 bool power_off_when_done;
 
+/* -trace: Record scheduler events? */
+static bool trace_sched;
+
 bool thread_tests;
 
 static void bss_init (void);
 static void paging_init (uint64_t mem_end);
+static bool cpu_has_gb_pages (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
@@ -102,9 +112,12 @@ main (void) {
 	syscall_init ();
 #endif
 	/* Start thread scheduler and enable interrupts. */
+	if (trace_sched)
+		trace_init ();
 	thread_start ();
 	serial_init_queue ();
 	timer_calibrate ();
+	hrtimer_init ();
 
 #ifdef FILESYS
 	/* Initialize file system. */
@@ -142,29 +155,65 @@ bss_init (void) {
 
 /* Populates the page table with the kernel virtual mapping,
  * and then sets up the CPU to use the new page directory.
- * Points base_pml4 to the pml4 it creates. */
+ * Points base_pml4 to the pml4 it creates.
+ *
+ * Memory is mapped with 1 GB pages where the CPU supports them,
+ * otherwise 2 MB pages, except where a large page would not fit
+ * below MEM_END or would cover kernel text, which must be
+ * read-only while the data next to it is not.  Those parts are
+ * mapped with 4 kB pages. */
 static void
 paging_init (uint64_t mem_end) {
 	uint64_t *pml4, *pte;
+	uint64_t size;
 	int perm;
 	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 
 	extern char start, _end_kernel_text;
+	uint64_t text_start = vtop (&start);
+	uint64_t text_end = vtop (&_end_kernel_text);
+	bool gb_pages = cpu_has_gb_pages ();
+
 	// Maps physical address [0 ~ mem_end] to
 	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
+	for (uint64_t pa = 0; pa < mem_end; pa += size) {
 		uint64_t va = (uint64_t) ptov(pa);
 
+		for (size = gb_pages ? PDPE_PGSIZE : PDE_PGSIZE; size > PGSIZE;
+				size = size == PDPE_PGSIZE ? PDE_PGSIZE : PGSIZE)
+			if (pa % size == 0 && pa + size <= mem_end
+					&& (pa + size <= text_start || text_end <= pa))
+				break;
+
 		perm = PTE_P | PTE_W;
-		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
+		if (text_start <= pa && pa < text_end)
 			perm &= ~PTE_W;
 
-		if ((pte = pml4e_walk (pml4, va, 1)) != NULL)
+		if (size == PGSIZE)
+			pte = pml4e_walk (pml4, va, 1);
+		else {
+			pte = pml4e_walk_large (pml4, va, size, 1);
+			perm |= PTE_PS;
+		}
+		if (pte != NULL)
 			*pte = pa | perm;
 	}
 
 	// reload cr3
 	pml4_activate(0);
+	pml4_init_pcid ();
+}
+
+/* Returns true if the CPU supports 1 GB pages. */
+static bool
+cpu_has_gb_pages (void) {
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid (0x80000000, &eax, &ebx, &ecx, &edx);
+	if (eax < 0x80000001)
+		return false;
+	cpuid (0x80000001, &eax, &ebx, &ecx, &edx);
+	return (edx & (1u << 26)) != 0;
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -221,6 +270,10 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-nohz"))
+			timer_nohz = true;
+		else if (!strcmp (name, "-trace"))
+			trace_sched = true;
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
@@ -266,6 +319,8 @@ run_actions (char **argv) {
 	/* Table of supported actions. */
 	static const struct action actions[] = {
 		{"run", 2, run_task},
+		{"dump-trace", 1, trace_dump},
+		{"lockstat", 2, lockstat_start},
 #ifdef FILESYS
 		{"ls", 1, fsutil_ls},
 		{"cat", 2, fsutil_cat},
@@ -312,6 +367,8 @@ usage (void) {
 #else
 			"  run TEST           Run TEST.\n"
 #endif
+			"  dump-trace         Print the scheduler event trace (see -trace).\n"
+			"  lockstat N         Profile locks; print the top N at power off.\n"
 #ifdef FILESYS
 			"  ls                 List files in the root directory.\n"
 			"  cat FILE           Print FILE to the console.\n"
@@ -326,6 +383,8 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -nohz              Stop the timer tick while the CPU is idle.\n"
+			"  -trace             Record scheduler events for dump-trace.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -353,7 +412,13 @@ power_off (void) {
 static void
 print_stats (void) {
 	timer_print_stats ();
+	hrtimer_print_stats ();
 	thread_print_stats ();
+	intr_print_stats ();
+	softirq_print_stats ();
+	lockstat_print_stats ();
+	palloc_print_stats ();
+	kmem_cache_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
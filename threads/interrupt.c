@@ -8,7 +8,9 @@
 #include "threads/io.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
+#include "threads/softirq.h"
 #include "threads/vaddr.h"
+#include "devices/lapic.h"
 #include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
@@ -103,6 +105,14 @@ static const char *intr_names[INTR_CNT];
 static bool in_external_intr;   /* Are we processing an external interrupt? */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
 
+/* Longest stretch with interrupts disabled, from intr_disable()
+   or interrupt entry to intr_enable() or interrupt return, in
+   TSC cycles.  Stretches that end otherwise, such as by `sti' in
+   the idle thread or a switch to user mode, are not measured. */
+static uint64_t intr_off_tsc;   /* When interrupts were last disabled. */
+static uint64_t intr_off_max;   /* Longest stretch seen. */
+static void intr_off_end (void);
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
@@ -137,6 +147,9 @@ intr_enable (void) {
 	enum intr_level old_level = intr_get_level ();
 	ASSERT (!intr_context ());
 
+	if (old_level == INTR_OFF)
+		intr_off_end ();
+
 	/* Enable interrupts by setting the interrupt flag.
 
 	   See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
@@ -156,9 +169,30 @@ intr_disable (void) {
 	   Hardware Interrupts". */
 	asm volatile ("cli" : : : "memory");
 
+	if (old_level == INTR_ON)
+		intr_off_tsc = rdtsc ();
 	return old_level;
 }
 
+/* Ends a stretch with interrupts disabled.  Interrupts must still
+   be off. */
+static void
+intr_off_end (void) {
+	uint64_t delta = rdtsc () - intr_off_tsc;
+
+	if (delta > intr_off_max)
+		intr_off_max = delta;
+}
+
+/* Prints interrupt statistics. */
+void
+intr_print_stats (void) {
+	uint64_t hz = timer_tsc_hz ();
+
+	printf ("Interrupts: off for at most %"PRIu64" cycles (%"PRIu64" us)\n",
+			intr_off_max, hz != 0 ? intr_off_max * 1000000 / hz : 0);
+}
+
 /* Initializes the interrupt system. */
 void
 intr_init (void) {
@@ -223,11 +257,12 @@ register_handler (uint8_t vec_no, int dpl, enum intr_level level,
 
 /* Registers external interrupt VEC_NO to invoke HANDLER, which
    is named NAME for debugging purposes.  The handler will
-   execute with interrupts disabled. */
+   execute with interrupts disabled.  Vectors 0x20...0x2f belong
+   to the PICs and 0x30...0x3f to the local APIC. */
 void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
 		const char *name) {
-	ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+	ASSERT (vec_no >= 0x20 && vec_no <= 0x3f);
 	register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
@@ -248,7 +283,7 @@ void
 intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 		intr_handler_func *handler, const char *name)
 {
-	ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+	ASSERT (vec_no < 0x20 || vec_no > 0x3f);
 	register_handler (vec_no, dpl, level, handler, name);
 }
 
@@ -259,13 +294,13 @@ intr_context (void) {
 	return in_external_intr;
 }
 
-/* During processing of an external interrupt, directs the
-   interrupt handler to yield to a new process just before
-   returning from the interrupt.  May not be called at any other
-   time. */
+/* During processing of an external interrupt or of a softirq,
+   directs the interrupt handler to yield to a new process just
+   before returning from the interrupt.  May not be called at any
+   other time. */
 void
 intr_yield_on_return (void) {
-	ASSERT (intr_context ());
+	ASSERT (intr_context () || softirq_context ());
 	yield_on_return = true;
 }
 
@@ -331,19 +366,34 @@ pic_end_of_interrupt (int irq) {
 void
 intr_handler (struct intr_frame *frame) {
 	bool external;
+	bool from_user = (frame->cs & 3) == 3;
+	bool timed = false;
 	intr_handler_func *handler;
 
+	/* Charge the time up to here to user mode. */
+	if (from_user)
+		thread_account (true);
+
 	/* External interrupts are special.
 	   We only handle one at a time (so interrupts must be off)
 	   and they need to be acknowledged on the PIC (see below).
 	   An external interrupt handler cannot sleep. */
-	external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+	external = frame->vec_no >= 0x20 && frame->vec_no < 0x40;
 	if (external) {
 		ASSERT (intr_get_level () == INTR_OFF);
 		ASSERT (!intr_context ());
 
 		in_external_intr = true;
-		yield_on_return = false;
+
+		/* Restart the periodic tick if the idle CPU stopped it. */
+		timer_idle_exit ();
+	}
+
+	/* An interrupt gate taken with interrupts on starts a stretch
+	   with them off. */
+	if (intr_get_level () == INTR_OFF && (frame->eflags & FLAG_IF)) {
+		intr_off_tsc = rdtsc ();
+		timed = true;
 	}
 
 	/* Invoke the interrupt's handler. */
@@ -367,11 +417,28 @@ intr_handler (struct intr_frame *frame) {
 		ASSERT (intr_context ());
 
 		in_external_intr = false;
-		pic_end_of_interrupt (frame->vec_no);
-
-		if (yield_on_return)
-			thread_yield ();
+		if (frame->vec_no < 0x30)
+			pic_end_of_interrupt (frame->vec_no);
+		else
+			lapic_eoi ();
+
+		/* Run the bottom halves, unless this interrupt arrived
+		   while they were running.  In that case the run it
+		   interrupted picks up both the softirqs raised and the
+		   request to yield. */
+		if (!softirq_context ()) {
+			softirq_run ();
+			if (yield_on_return) {
+				yield_on_return = false;
+				thread_yield ();
+			}
+		}
 	}
+
+	if (timed)
+		intr_off_end ();
+	if (from_user)
+		thread_account (false);
 }
 
 /* Dumps interrupt frame F to the console, for debugging. */
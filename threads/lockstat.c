@@ -0,0 +1,125 @@
+#include "threads/lockstat.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "threads/interrupt.h"
+
+/* Maximum number of classes printed. */
+#define LOCKSTAT_TOP_MAX 32
+
+/* True while statistics are being collected. */
+bool lockstat_enabled;
+
+/* Number of classes to print at power off. */
+static int lockstat_top;
+
+/* All classes that have had a semaphore or lock initialized. */
+static struct lock_class *classes;
+
+/* Adds CLASS to the list of classes, if it is not there yet. */
+void
+lockstat_register (struct lock_class *class) {
+	enum intr_level old_level = intr_disable ();
+
+	if (!class->registered) {
+		class->registered = true;
+		class->next = classes;
+		classes = class;
+	}
+	intr_set_level (old_level);
+}
+
+/* Counts an acquisition of a lock or semaphore of CLASS that
+   waited WAIT_CYCLES, and that had to wait at all if
+   CONTENDED.  Must be called with interrupts off. */
+void
+lockstat_acquired (struct lock_class *class, uint64_t wait_cycles,
+		bool contended) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	class->acquired++;
+	if (contended) {
+		class->contended++;
+		class->wait_cycles += wait_cycles;
+		if (wait_cycles > class->wait_max)
+			class->wait_max = wait_cycles;
+	}
+}
+
+/* Counts HOLD_CYCLES that a lock of CLASS was held.  Must be
+   called with interrupts off. */
+void
+lockstat_released (struct lock_class *class, uint64_t hold_cycles) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	class->hold_cycles += hold_cycles;
+}
+
+/* "lockstat N" action: starts collecting statistics, to print
+   the N classes with the most wait time at power off. */
+void
+lockstat_start (char **argv) {
+	int top = atoi (argv[1]);
+
+	if (top < 1)
+		top = 1;
+	else if (top > LOCKSTAT_TOP_MAX)
+		top = LOCKSTAT_TOP_MAX;
+	lockstat_top = top;
+	lockstat_enabled = true;
+}
+
+/* Returns true if class A has waited longer than class B,
+   breaking ties by the number of contended acquisitions. */
+static bool
+class_more (const struct lock_class *a, const struct lock_class *b) {
+	if (a->wait_cycles != b->wait_cycles)
+		return a->wait_cycles > b->wait_cycles;
+	return a->contended > b->contended;
+}
+
+/* Strips the build directory's "../../" from source file FILE. */
+static const char *
+short_file (const char *file) {
+	while (file[0] == '.' && file[1] == '.' && file[2] == '/')
+		file += 3;
+	return file;
+}
+
+/* Prints the lockstat_top classes with the most wait time. */
+void
+lockstat_print_stats (void) {
+	struct lock_class *top[LOCKSTAT_TOP_MAX];
+	struct lock_class *c;
+	int cnt = 0;
+	int i;
+
+	if (!lockstat_enabled)
+		return;
+	lockstat_enabled = false;
+
+	/* Insertion sort into TOP, keeping the LOCKSTAT_TOP best. */
+	for (c = classes; c != NULL; c = c->next) {
+		if (c->acquired == 0)
+			continue;
+		for (i = cnt; i > 0 && class_more (c, top[i - 1]); i--)
+			if (i < lockstat_top)
+				top[i] = top[i - 1];
+		if (i < lockstat_top) {
+			top[i] = c;
+			if (cnt < lockstat_top)
+				cnt++;
+		}
+	}
+
+	printf ("Locks: top %d classes by wait cycles\n", cnt);
+	printf ("%12s %10s %14s %12s %14s  %s\n", "acquired", "contended",
+			"wait", "wait-max", "hold", "class");
+	for (i = 0; i < cnt; i++)
+		printf ("%12"PRIu64" %10"PRIu64" %14"PRIu64" %12"PRIu64
+				" %14"PRIu64"  %s (%s:%d)\n",
+				top[i]->acquired, top[i]->contended, top[i]->wait_cycles,
+				top[i]->wait_max, top[i]->hold_cycles, top[i]->name,
+				short_file (top[i]->file), top[i]->line);
+}
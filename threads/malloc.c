@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -12,10 +13,11 @@
 /* A simple implementation of malloc().
 
    The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
-   satisfy the request.
+   of 2, or above 1 kB to one of the mid-size classes below, and
+   assigned to the "descriptor" that manages blocks of that size.
+   The descriptor keeps a list of free blocks.  If the free list
+   is nonempty, one of its blocks is used to satisfy the
+   request.
 
    Otherwise, a new page of memory, called an "arena", is
    obtained from the page allocator (if none is available,
@@ -28,18 +30,53 @@
    blocks, we remove all of the arena's blocks from the free list
    and give the arena back to the page allocator.
 
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   Blocks bigger than 1 kB would waste too much of a single-page
+   arena, so mid-size descriptors instead split an arena of 2**K
+   contiguous pages, for K up to 5, three or two ways.  Each page
+   of such an arena after the first is tagged, through
+   palloc_set_tag(), with its offset from the first, so that a
+   block can find its arena header.  This turns a 2.1 kB request,
+   say, into a third of two pages instead of two whole pages.
+
+   We can't handle blocks bigger than 64 kB using this scheme.
+   We handle those by allocating contiguous pages with the page
+   allocator and sticking the allocation size at the beginning of
+   the allocated block's arena header.
+
+   In front of each descriptor sits a "magazine": a small stack
+   of free blocks that malloc() and free() pop and push with
+   interrupts disabled, without taking the descriptor's lock.
+   An empty magazine is refilled, and a full one drained, half a
+   magazine at a time under the lock, so that most calls never
+   touch the lock or the arena headers.  Mid-size blocks
+   get small magazines, so as not to strand too much memory.
+   Blocks sitting in a magazine still count as in use in their
+   arenas, so an arena is only freed once its blocks have all
+   been drained back. */
+
+/* Blocks a magazine holds, for small and mid-size blocks. */
+#define MAG_SIZE 16
+#define MAG_SIZE_MID 2
+
+/* Most pages in a mid-size arena. */
+#define MID_ARENA_PAGES 32
+
+/* Cache of free blocks.  Protected by disabling interrupts,
+   which suffices while only one CPU runs the kernel. */
+struct magazine {
+	size_t cnt;                 /* Number of blocks held. */
+	struct block *blocks[MAG_SIZE]; /* Free blocks, a stack. */
+};
 
 /* Descriptor. */
 struct desc {
 	size_t block_size;          /* Size of each element in bytes. */
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
+	size_t arena_pages;         /* Number of pages in an arena. */
+	size_t mag_size;            /* Blocks each magazine holds. */
 	struct list free_list;      /* List of free blocks. */
 	struct lock lock;           /* Lock. */
+	struct magazine mag;        /* Cache in front of free_list. */
 };
 
 /* Magic number for detecting arena corruption. */
@@ -58,31 +95,60 @@ struct block {
 };
 
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[20];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+static void desc_init (size_t block_size, size_t arena_pages,
+		size_t mag_size);
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct block *mag_refill (struct desc *);
+static void mag_drain (struct desc *, struct block *);
+static size_t desc_get_blocks (struct desc *, struct block **, size_t cnt);
+static void desc_put_blocks (struct desc *, struct block **, size_t cnt);
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) {
-	size_t block_size;
-
-	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
-		struct desc *d = &descs[desc_cnt++];
-		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-		d->block_size = block_size;
-		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
-		list_init (&d->free_list);
-		lock_init (&d->lock);
-	}
+	size_t block_size, arena_pages, split;
+
+	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+		desc_init (block_size, 1, MAG_SIZE);
+
+	for (arena_pages = 1; arena_pages <= MID_ARENA_PAGES; arena_pages *= 2)
+		for (split = 3; split >= 2; split--) {
+			block_size = ROUND_DOWN ((arena_pages * PGSIZE
+						- sizeof (struct arena)) / split, 8);
+			if (block_size > descs[desc_cnt - 1].block_size)
+				desc_init (block_size, arena_pages, MAG_SIZE_MID);
+		}
+}
+
+/* Initializes the next descriptor, for blocks of BLOCK_SIZE bytes
+   in arenas of ARENA_PAGES pages, with magazines of MAG_SIZE
+   blocks. */
+static void
+desc_init (size_t block_size, size_t arena_pages, size_t mag_size) {
+	struct desc *d = &descs[desc_cnt++];
+
+	ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+	ASSERT (mag_size <= MAG_SIZE);
+	d->block_size = block_size;
+	d->arena_pages = arena_pages;
+	d->blocks_per_arena = (arena_pages * PGSIZE - sizeof (struct arena))
+		/ block_size;
+	d->mag_size = mag_size;
+	list_init (&d->free_list);
+	lock_init (&d->lock);
+	d->mag.cnt = 0;
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) {
+	enum intr_level old_level;
+	struct magazine *m;
 	struct desc *d;
 	struct block *b;
 	struct arena *a;
@@ -112,35 +178,14 @@ malloc (size_t size) {
 		return a + 1;
 	}
 
-	lock_acquire (&d->lock);
-
-	/* If the free list is empty, create a new arena. */
-	if (list_empty (&d->free_list)) {
-		size_t i;
-
-		/* Allocate a page. */
-		a = palloc_get_page (0);
-		if (a == NULL) {
-			lock_release (&d->lock);
-			return NULL;
-		}
-
-		/* Initialize arena and add its blocks to the free list. */
-		a->magic = ARENA_MAGIC;
-		a->desc = d;
-		a->free_cnt = d->blocks_per_arena;
-		for (i = 0; i < d->blocks_per_arena; i++) {
-			struct block *b = arena_to_block (a, i);
-			list_push_back (&d->free_list, &b->free_elem);
-		}
-	}
+	/* Pop a block from the magazine, refilling it from the
+	   descriptor if it is empty. */
+	old_level = intr_disable ();
+	m = &d->mag;
+	b = m->cnt > 0 ? m->blocks[--m->cnt] : NULL;
+	intr_set_level (old_level);
 
-	/* Get a block from free list and return it. */
-	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-	a = block_to_arena (b);
-	a->free_cnt--;
-	lock_release (&d->lock);
-	return b;
+	return b != NULL ? b : mag_refill (d);
 }
 
 /* Allocates and return A times B bytes initialized to zeroes.
@@ -213,24 +258,18 @@ free (void *p) {
 			memset (b, 0xcc, d->block_size);
 #endif
 
-			lock_acquire (&d->lock);
+			/* Push the block on the magazine, draining it to the
+			   descriptor if it is full. */
+			enum intr_level old_level = intr_disable ();
+			struct magazine *m = &d->mag;
+			bool cached = m->cnt < d->mag_size;
 
-			/* Add block to free list. */
-			list_push_front (&d->free_list, &b->free_elem);
+			if (cached)
+				m->blocks[m->cnt++] = b;
+			intr_set_level (old_level);
 
-			/* If the arena is now entirely unused, free it. */
-			if (++a->free_cnt >= d->blocks_per_arena) {
-				size_t i;
-
-				ASSERT (a->free_cnt == d->blocks_per_arena);
-				for (i = 0; i < d->blocks_per_arena; i++) {
-					struct block *b = arena_to_block (a, i);
-					list_remove (&b->free_elem);
-				}
-				palloc_free_page (a);
-			}
-
-			lock_release (&d->lock);
+			if (!cached)
+				mag_drain (d, b);
 		} else {
 			/* It's a big block.  Free its pages. */
 			palloc_free_multiple (a, a->free_cnt);
@@ -239,18 +278,138 @@ free (void *p) {
 	}
 }
 
+/* Refills D's magazine with a batch of blocks from D's free
+   list, and returns one more for the caller.  Returns a null
+   pointer if memory is not available. */
+static struct block *
+mag_refill (struct desc *d) {
+	struct block *batch[MAG_SIZE / 2 + 1];
+	struct magazine *m;
+	enum intr_level old_level;
+	size_t cnt, i;
+
+	cnt = desc_get_blocks (d, batch, d->mag_size / 2 + 1);
+	if (cnt == 0)
+		return NULL;
+
+	/* Another thread may have refilled the magazine since we found
+	   it empty, so load only as much as fits and give the rest
+	   back. */
+	old_level = intr_disable ();
+	m = &d->mag;
+	for (i = 1; i < cnt && m->cnt < d->mag_size; i++)
+		m->blocks[m->cnt++] = batch[i];
+	intr_set_level (old_level);
+
+	if (i < cnt)
+		desc_put_blocks (d, batch + i, cnt - i);
+	return batch[0];
+}
+
+/* Frees B, whose magazine for D is full, by moving B and a
+   batch of blocks from the magazine back to D's free list. */
+static void
+mag_drain (struct desc *d, struct block *b) {
+	struct block *batch[MAG_SIZE / 2 + 1];
+	struct magazine *m;
+	enum intr_level old_level;
+	size_t cnt = 0;
+
+	batch[cnt++] = b;
+	old_level = intr_disable ();
+	m = &d->mag;
+	while (cnt < d->mag_size / 2 + 1 && m->cnt > 0)
+		batch[cnt++] = m->blocks[--m->cnt];
+	intr_set_level (old_level);
+
+	desc_put_blocks (d, batch, cnt);
+}
+
+/* Takes up to CNT blocks from D's free list into BLOCKS, creating
+   an arena if the list is empty, and returns the number taken.
+   Returns 0 only if memory is not available. */
+static size_t
+desc_get_blocks (struct desc *d, struct block **blocks, size_t cnt) {
+	struct arena *a;
+	size_t i;
+
+	lock_acquire (&d->lock);
+
+	/* If the free list is empty, create a new arena. */
+	if (list_empty (&d->free_list)) {
+		/* Allocate pages, tagging each with its offset. */
+		a = palloc_get_multiple (0, d->arena_pages);
+		if (a == NULL) {
+			lock_release (&d->lock);
+			return 0;
+		}
+		for (i = 1; i < d->arena_pages; i++)
+			palloc_set_tag ((uint8_t *) a + i * PGSIZE, i);
+
+		/* Initialize arena and add its blocks to the free list. */
+		a->magic = ARENA_MAGIC;
+		a->desc = d;
+		a->free_cnt = d->blocks_per_arena;
+		for (i = 0; i < d->blocks_per_arena; i++) {
+			struct block *b = arena_to_block (a, i);
+			list_push_back (&d->free_list, &b->free_elem);
+		}
+	}
+
+	/* Get blocks from the free list. */
+	for (i = 0; i < cnt && !list_empty (&d->free_list); i++) {
+		blocks[i] = list_entry (list_pop_front (&d->free_list),
+				struct block, free_elem);
+		a = block_to_arena (blocks[i]);
+		a->free_cnt--;
+	}
+	lock_release (&d->lock);
+	return i;
+}
+
+/* Returns the CNT blocks in BLOCKS to D's free list, freeing the
+   arenas left entirely unused. */
+static void
+desc_put_blocks (struct desc *d, struct block **blocks, size_t cnt) {
+	size_t i, j;
+
+	lock_acquire (&d->lock);
+	for (i = 0; i < cnt; i++) {
+		struct block *b = blocks[i];
+		struct arena *a = block_to_arena (b);
+
+		/* Add block to free list. */
+		list_push_front (&d->free_list, &b->free_elem);
+
+		/* If the arena is now entirely unused, free it. */
+		if (++a->free_cnt >= d->blocks_per_arena) {
+			ASSERT (a->free_cnt == d->blocks_per_arena);
+			for (j = 0; j < d->blocks_per_arena; j++) {
+				struct block *b = arena_to_block (a, j);
+				list_remove (&b->free_elem);
+			}
+			palloc_free_multiple (a, d->arena_pages);
+		}
+	}
+	lock_release (&d->lock);
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
 	struct arena *a = pg_round_down (b);
 
+	/* Step back to the first page of a mid-size arena. */
+	a = (struct arena *) ((uint8_t *) a - palloc_get_tag (a) * PGSIZE);
+
 	/* Check that the arena is valid. */
 	ASSERT (a != NULL);
 	ASSERT (a->magic == ARENA_MAGIC);
 
 	/* Check that the block is properly aligned for the arena. */
 	ASSERT (a->desc == NULL
-			|| (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
+			|| ((uint8_t *) b - (uint8_t *) (a + 1))
+				% a->desc->block_size == 0);
 	ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
 
 	return a;
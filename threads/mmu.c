@@ -2,18 +2,182 @@
 #include <stddef.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* Process-context identifiers (PCIDs).
+
+   With CR4.PCIDE set, the CPU tags each TLB entry with the 12-bit
+   PCID in the low bits of CR3, and loading CR3 with CR3_NOFLUSH
+   keeps the entries of other PCIDs, so switching between processes
+   need not flush the TLB.
+
+   Each user pml4 gets an address-space ID (ASID) to use as its
+   PCID.  ASIDs are handed out in order within a generation; when
+   they run out, a new generation starts by flushing the entries of
+   every PCID, so an ASID is never handed out again while the TLB
+   may hold entries tagged with it.  A pml4 whose ASID is from an
+   older generation gets a new one when next activated.  PCID 0
+   belongs to base_pml4.  Like the rest of the kernel, this
+   assumes a single CPU.
+
+   A pml4's ASID and generation are kept in its last entry, which
+   maps no address the kernel uses.  The entry is never marked
+   present, so the CPU ignores the rest of it. */
+
+#define CR4_PCIDE (1UL << 17)           /* PCIDs enabled. */
+#define CR3_NOFLUSH (1UL << 63)         /* Keep the PCID's entries. */
+#define CPUID_1_ECX_PCID (1u << 17)     /* PCIDs supported. */
+#define CPUID_7_EBX_INVPCID (1u << 10)  /* INVPCID supported. */
+
+/* INVPCID types. */
+#define INVPCID_ADDR 0                  /* One address of one PCID. */
+#define INVPCID_PCID 1                  /* All addresses of one PCID. */
+#define INVPCID_ALL 2                   /* Every PCID, even globals. */
+
+#define ASID_MAX 0xfff                  /* Highest ASID. */
+#define ASID_SLOT (PGSIZE / sizeof (uint64_t) - 1)  /* pml4 entry. */
+
+static bool pcid_enabled;       /* CR4.PCIDE is set. */
+static bool has_invpcid;        /* INVPCID is available. */
+static uint64_t asid_gen = 1;   /* Current generation. */
+static unsigned asid_next = 1;  /* Next ASID to hand out. */
+
+/* Returns PML4's ASID, or 0 if it has none in the current
+ * generation. */
+static unsigned
+pml4_asid (uint64_t *pml4) {
+	uint64_t slot = pml4[ASID_SLOT];
+
+	return (slot >> 13) == asid_gen ? (slot >> 1) & ASID_MAX : 0;
+}
+
+/* Gives PML4 a new ASID and returns it, starting a new generation
+ * if the current one has run out.  Interrupts must be off. */
+static unsigned
+asid_alloc (uint64_t *pml4) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (asid_next > ASID_MAX) {
+		asid_gen++;
+		asid_next = 1;
+
+		/* Flush the entries of every PCID.  Without INVPCID, clearing
+		   CR4.PCIDE does it, but setting it again requires PCID 0. */
+		if (has_invpcid)
+			invpcid (INVPCID_ALL, 0, 0);
+		else {
+			lcr3 (vtop (base_pml4));
+			lcr4 (rcr4 () & ~CR4_PCIDE);
+			lcr4 (rcr4 () | CR4_PCIDE);
+		}
+	}
+	pml4[ASID_SLOT] = asid_gen << 13 | (uint64_t) asid_next << 1;
+	return asid_next++;
+}
+
+/* Invalidates the TLB entry for user virtual address VA in PML4,
+ * which need not be active. */
+static void
+pml4_invalidate (uint64_t *pml4, const void *va) {
+	enum intr_level old_level = intr_disable ();
+	unsigned asid;
+
+	if (PTE_ADDR (rcr3 ()) == vtop (pml4))
+		invlpg ((uint64_t) va);
+	else if (pcid_enabled && (asid = pml4_asid (pml4)) != 0) {
+		if (has_invpcid)
+			invpcid (INVPCID_ADDR, asid, (uint64_t) va);
+		else
+			pml4[ASID_SLOT] = 0;        /* Take a fresh ASID instead. */
+	}
+	intr_set_level (old_level);
+}
+
+/* Invalidates all of PML4's TLB entries.  PML4 need not be
+ * active. */
+static void
+pml4_flush (uint64_t *pml4) {
+	enum intr_level old_level = intr_disable ();
+	unsigned asid;
+
+	if (PTE_ADDR (rcr3 ()) == vtop (pml4))
+		lcr3 (rcr3 ());
+	else if (pcid_enabled && (asid = pml4_asid (pml4)) != 0) {
+		if (has_invpcid)
+			invpcid (INVPCID_PCID, asid, 0);
+		else
+			pml4[ASID_SLOT] = 0;
+	}
+	intr_set_level (old_level);
+}
+
+/* Turns on PCIDs, if the CPU supports them.  base_pml4 must be
+ * active. */
+void
+pml4_init_pcid (void) {
+	uint32_t eax, ebx, ecx, edx;
+
+	ASSERT (rcr3 () == vtop (base_pml4));
+	ASSERT (base_pml4[ASID_SLOT] == 0);
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if (!(ecx & CPUID_1_ECX_PCID))
+		return;
+	cpuid (0, &eax, &ebx, &ecx, &edx);
+	if (eax >= 7) {
+		cpuid (7, &eax, &ebx, &ecx, &edx);
+		has_invpcid = (ebx & CPUID_7_EBX_INVPCID) != 0;
+	}
+	lcr4 (rcr4 () | CR4_PCIDE);
+	pcid_enabled = true;
+}
+
+/* Returns true if ENTRY, a PDE or PDPE, maps a large page rather
+ * than pointing to a table. */
+static inline bool
+is_large_leaf (uint64_t entry) {
+	return (entry & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS);
+}
+
+/* Replaces the large page of SIZE bytes that *ENTRY maps with a
+ * table mapping the same memory, with the same permissions, in
+ * pages of the next smaller size.  The translation does not
+ * change, so TLB entries for the large page stay valid until the
+ * caller changes one of the smaller pages.  Returns false if
+ * memory allocation fails. */
+static bool
+split_large_page (uint64_t *entry, uint64_t size) {
+	uint64_t sub_size = size / (PGSIZE / sizeof *entry);
+	uint64_t flags = *entry & PTE_FLAGS;
+	uint64_t pa = PTE_ADDR (*entry) & ~(size - 1);
+	uint64_t *table = palloc_get_page (0);
+
+	if (table == NULL)
+		return false;
+	if (sub_size == PTE_PGSIZE)
+		flags &= ~PTE_PS;
+	for (unsigned i = 0; i < PGSIZE / sizeof *entry; i++)
+		table[i] = (pa + i * sub_size) | flags;
+	*entry = vtop (table) | PTE_U | PTE_W | PTE_P;
+	return true;
+}
+
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
 	if (pdp) {
 		uint64_t *pte = (uint64_t *) pdp[idx];
-		if (!((uint64_t) pte & PTE_P)) {
+		if (is_large_leaf (pdp[idx])) {
+			if (!create)
+				return &pdp[idx];
+			if (!split_large_page (&pdp[idx], PDE_PGSIZE))
+				return NULL;
+		} else if (!((uint64_t) pte & PTE_P)) {
 			if (create) {
 				uint64_t *new_page = palloc_get_page (PAL_ZERO);
 				if (new_page)
@@ -35,7 +199,12 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
 	int allocated = 0;
 	if (pdpe) {
 		uint64_t *pde = (uint64_t *) pdpe[idx];
-		if (!((uint64_t) pde & PTE_P)) {
+		if (is_large_leaf (pdpe[idx])) {
+			if (!create)
+				return &pdpe[idx];
+			if (!split_large_page (&pdpe[idx], PDPE_PGSIZE))
+				return NULL;
+		} else if (!((uint64_t) pde & PTE_P)) {
 			if (create) {
 				uint64_t *new_page = palloc_get_page (PAL_ZERO);
 				if (new_page) {
@@ -60,7 +229,11 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
  * If PML4E does not have a page table for VADDR, behavior depends
  * on CREATE.  If CREATE is true, then a new page table is
  * created and a pointer into it is returned.  Otherwise, a null
- * pointer is returned. */
+ * pointer is returned.
+ * If VADDR lies in a large page, then with CREATE the large page
+ * is split down to page tables, and without it the PDE or PDPE
+ * that maps the large page is returned; see pml4e_lookup() to
+ * tell the two apart. */
 uint64_t *
 pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	uint64_t *pte = NULL;
@@ -88,6 +261,61 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	return pte;
 }
 
+/* Returns the address of the entry that maps virtual address VA
+ * in PML4, which is a PTE, or the PDE or PDPE of a large page, and
+ * stores the number of bytes that entry maps in *SIZE if SIZE is
+ * nonnull.  Returns a null pointer if no page table covers VA. */
+uint64_t *
+pml4e_lookup (uint64_t *pml4, const uint64_t va, uint64_t *size) {
+	uint64_t *table = pml4;
+
+	for (uint64_t shift = PML4SHIFT; ; shift -= PDXSHIFT - PTXSHIFT) {
+		uint64_t *entry = &table[(va >> shift) & 0x1FF];
+
+		if (shift == PTXSHIFT
+				|| (shift <= PDPESHIFT && is_large_leaf (*entry))) {
+			if (size != NULL)
+				*size = 1UL << shift;
+			return entry;
+		}
+		if (!(*entry & PTE_P))
+			return NULL;
+		table = ptov (PTE_ADDR (*entry));
+	}
+}
+
+/* Returns the address of the PDE (if SIZE is PDE_PGSIZE) or PDPE
+ * (if SIZE is PDPE_PGSIZE) that maps, or would map, the large page
+ * containing VA in PML4, creating the tables above it as needed,
+ * and splitting any larger page in the way, if CREATE is true.
+ * Returns a null pointer if there is no such entry and CREATE is
+ * false, or if memory allocation fails. */
+uint64_t *
+pml4e_walk_large (uint64_t *pml4, const uint64_t va, uint64_t size,
+		int create) {
+	uint64_t *table = pml4;
+
+	ASSERT (size == PDE_PGSIZE || size == PDPE_PGSIZE);
+
+	for (uint64_t shift = PML4SHIFT; ; shift -= PDXSHIFT - PTXSHIFT) {
+		uint64_t *entry = &table[(va >> shift) & 0x1FF];
+
+		if ((1UL << shift) == size)
+			return entry;
+		if (is_large_leaf (*entry)) {
+			if (!create || !split_large_page (entry, 1UL << shift))
+				return NULL;
+		} else if (!(*entry & PTE_P)) {
+			uint64_t *new_page;
+
+			if (!create || (new_page = palloc_get_page (PAL_ZERO)) == NULL)
+				return NULL;
+			*entry = vtop (new_page) | PTE_U | PTE_W | PTE_P;
+		}
+		table = ptov (PTE_ADDR (*entry));
+	}
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
@@ -117,12 +345,40 @@ pt_for_each (uint64_t *pt, pte_for_each_func *func, void *aux,
 	return true;
 }
 
+/* Applies FUNC to each 4 kB page of the 2 MB user huge page that
+ * PDE maps at VA.  There is no PTE for such a page, so FUNC gets a
+ * copy of the PTE that would map it, and changes it makes to the
+ * copy are lost.  A caller that needs to change the mapping of
+ * single pages must split the huge page first. */
+static bool
+huge_for_each (uint64_t pde, uint8_t *va, pte_for_each_func *func,
+		void *aux) {
+	uint64_t flags = (pde & PTE_FLAGS) & ~PTE_PS;
+	uint64_t pa = PTE_ADDR (pde) & ~(PDE_PGSIZE - 1);
+
+	for (unsigned i = 0; i < PDE_PGSIZE / PGSIZE; i++) {
+		uint64_t pte = (pa + i * PGSIZE) | flags;
+		if (!func (&pte, va + i * PGSIZE, aux))
+			return false;
+	}
+	return true;
+}
+
 static bool
 pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if (is_large_leaf (pdp[i])) {
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) pdp_index << PDPESHIFT) |
+								 ((uint64_t) i << PDXSHIFT));
+			if (pdp[i] & PTE_U) {
+				if (!huge_for_each (pdp[i], va, func, aux))
+					return false;
+			} else if (!func (&pdp[i], va, aux))
+				return false;
+		} else if (((uint64_t) pte) & PTE_P)
 			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
 					pml4_index, pdp_index, i))
 				return false;
@@ -135,7 +391,12 @@ pdp_for_each (uint64_t *pdp,
 		pte_for_each_func *func, void *aux, unsigned pml4_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pde = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pde) & PTE_P)
+		if (is_large_leaf (pdp[i])) {
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) i << PDPESHIFT));
+			if (!func (&pdp[i], va, aux))
+				return false;
+		} else if (((uint64_t) pde) & PTE_P)
 			if (!pgdir_for_each ((uint64_t *) PTE_ADDR (pde), func,
 					 aux, pml4_index, i))
 				return false;
@@ -143,7 +404,11 @@ pdp_for_each (uint64_t *pdp,
 	return true;
 }
 
-/* Apply FUNC to each available pte entries including kernel's. */
+/* Apply FUNC to each available pte entries including kernel's.
+ * FUNC sees each 4 kB page of a user huge page separately, through
+ * a copy of the PTE that would map it; see huge_for_each().
+ * Kernel memory mapped with large pages is passed as the PDE or
+ * PDPE that maps it. */
 bool
 pml4_for_each (uint64_t *pml4, pte_for_each_func *func, void *aux) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
@@ -169,7 +434,10 @@ static void
 pgdir_destroy (uint64_t *pdp) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if (is_large_leaf (pdp[i]))
+			palloc_free_multiple ((void *) PTE_ADDR (pte),
+					PDE_PGSIZE / PGSIZE);
+		else if (((uint64_t) pte) & PTE_P)
 			pt_destroy (PTE_ADDR (pte));
 	}
 	palloc_free_page ((void *) pdp);
@@ -200,10 +468,29 @@ pml4_destroy (uint64_t *pml4) {
 }
 
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register.  With PCIDs, the TLB entries of PD's address space
+ * and of others are kept. */
 void
 pml4_activate (uint64_t *pml4) {
-	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	enum intr_level old_level;
+	unsigned asid;
+
+	if (pml4 == NULL)
+		pml4 = base_pml4;
+	if (!pcid_enabled) {
+		lcr3 (vtop (pml4));
+		return;
+	}
+
+	old_level = intr_disable ();
+	if (pml4 == base_pml4)
+		/* Maps only the kernel, which all PCIDs share. */
+		lcr3 (vtop (pml4) | CR3_NOFLUSH);
+	else if ((asid = pml4_asid (pml4)) != 0)
+		lcr3 (vtop (pml4) | asid | CR3_NOFLUSH);
+	else
+		lcr3 (vtop (pml4) | asid_alloc (pml4));
+	intr_set_level (old_level);
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -214,10 +501,12 @@ void *
 pml4_get_page (uint64_t *pml4, const void *uaddr) {
 	ASSERT (is_user_vaddr (uaddr));
 
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
+	uint64_t size;
+	uint64_t *pte = pml4e_lookup (pml4, (uint64_t) uaddr, &size);
 
 	if (pte && (*pte & PTE_P))
-		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
+		return ptov (PTE_ADDR (*pte) & ~(size - 1))
+			+ ((uint64_t) uaddr & (size - 1));
 	return NULL;
 }
 
@@ -238,27 +527,134 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) upage, 1);
 
-	if (pte)
+	if (pte) {
+		uint64_t old = *pte;
+
 		*pte = vtop (kpage) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+		if (old & PTE_P)
+			pml4_invalidate (pml4, upage);
+	}
 	return pte != NULL;
 }
 
+/* Adds a mapping in page map level 4 PML4 from the 2 MB user
+ * virtual huge page UPAGE to the 2 MB of physical memory at kernel
+ * virtual address KPAGE, which should probably be a block of
+ * PDE_PGSIZE / PGSIZE pages obtained from the user pool with
+ * palloc_get_multiple().  Both must be aligned to 2 MB, and no page
+ * in UPAGE may be mapped yet.  An empty page table left over from
+ * earlier mappings in UPAGE is freed.
+ * If WRITABLE is true, the new page is read/write;
+ * otherwise it is read-only.
+ * Returns true if successful, false if memory allocation
+ * failed or part of UPAGE is already mapped. */
+bool
+pml4_set_huge_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
+	ASSERT ((uint64_t) upage % PDE_PGSIZE == 0);
+	ASSERT ((uint64_t) kpage % PDE_PGSIZE == 0);
+	ASSERT (is_user_vaddr (upage));
+	ASSERT (pml4 != base_pml4);
+
+	uint64_t *pde = pml4e_walk_large (pml4, (uint64_t) upage, PDE_PGSIZE, 1);
+
+	if (pde == NULL)
+		return false;
+	if (*pde & PTE_P) {
+		uint64_t *pt;
+
+		if (is_large_leaf (*pde))
+			return false;
+		pt = ptov (PTE_ADDR (*pde));
+		for (unsigned i = 0; i < PGSIZE / sizeof *pt; i++)
+			if (pt[i] & PTE_P)
+				return false;
+		*pde = 0;
+		palloc_free_page (pt);
+	}
+	*pde = vtop (kpage) | PTE_PS | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+	pml4_invalidate (pml4, upage);
+	return true;
+}
+
+/* If the 2 MB user virtual page UPAGE in PML4 is mapped by a huge
+ * page, maps it instead with 4 kB pages of the same physical memory
+ * and permissions, so that they can be unmapped, protected or
+ * evicted one by one.  Returns false if memory allocation fails.
+ * Returns true, doing nothing, if UPAGE is not a huge page. */
+bool
+pml4_split_huge_page (uint64_t *pml4, void *upage) {
+	uint64_t *pde;
+
+	ASSERT ((uint64_t) upage % PDE_PGSIZE == 0);
+	ASSERT (is_user_vaddr (upage));
+
+	pde = pml4e_walk_large (pml4, (uint64_t) upage, PDE_PGSIZE, 0);
+	if (pde == NULL || !is_large_leaf (*pde))
+		return true;
+	return split_large_page (pde, PDE_PGSIZE);
+}
+
+/* If all of the 2 MB user virtual page UPAGE in PML4 is mapped, by
+ * 4 kB pages with the same permissions onto 2 MB of physical memory
+ * that is contiguous and aligned to 2 MB, replaces them with a
+ * single huge page and frees their page table.  Returns true if
+ * UPAGE is mapped by a huge page on return. */
+bool
+pml4_promote_huge_page (uint64_t *pml4, void *upage) {
+	const uint64_t same = PTE_P | PTE_W | PTE_U | PTE_PWT | PTE_PCD;
+	uint64_t *pde, *pt, base, flags;
+
+	ASSERT ((uint64_t) upage % PDE_PGSIZE == 0);
+	ASSERT (is_user_vaddr (upage));
+
+	pde = pml4e_walk_large (pml4, (uint64_t) upage, PDE_PGSIZE, 0);
+	if (pde == NULL || !(*pde & PTE_P))
+		return false;
+	if (is_large_leaf (*pde))
+		return true;
+
+	pt = ptov (PTE_ADDR (*pde));
+	base = PTE_ADDR (pt[0]);
+	if (!(pt[0] & PTE_P) || base % PDE_PGSIZE != 0)
+		return false;
+	flags = 0;
+	for (unsigned i = 0; i < PGSIZE / sizeof *pt; i++) {
+		if ((pt[i] & same) != (pt[0] & same)
+				|| PTE_ADDR (pt[i]) != base + i * PGSIZE)
+			return false;
+		flags |= pt[i] & (PTE_A | PTE_D);
+	}
+
+	*pde = base | (pt[0] & same) | flags | PTE_PS;
+	palloc_free_page (pt);
+
+	/* Changing the page size of a translation requires flushing the
+	   TLB entries for it; see [IA32-v3a] 4.10.2.3. */
+	pml4_flush (pml4);
+	return true;
+}
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
  * bits in the page table entry are preserved.
- * UPAGE need not be mapped. */
+ * UPAGE need not be mapped.
+ * If UPAGE lies in a huge page, the huge page is first split so
+ * that only UPAGE is affected, or, if that fails for lack of
+ * memory, all of the huge page is marked not present. */
 void
 pml4_clear_page (uint64_t *pml4, void *upage) {
 	uint64_t *pte;
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (is_user_vaddr (upage));
 
-	pte = pml4e_walk (pml4, (uint64_t) upage, false);
+	if (!pml4_split_huge_page (pml4, pg_round_down_huge (upage)))
+		pte = pml4e_walk_large (pml4, (uint64_t) upage, PDE_PGSIZE, false);
+	else
+		pte = pml4e_walk (pml4, (uint64_t) upage, false);
 
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
+		pml4_invalidate (pml4, upage);
 	}
 }
 
@@ -283,8 +679,7 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 		else
 			*pte &= ~(uint32_t) PTE_D;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		pml4_invalidate (pml4, vpage);
 	}
 }
 
@@ -309,7 +704,6 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 		else
 			*pte &= ~(uint32_t) PTE_A;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		pml4_invalidate (pml4, vpage);
 	}
 }
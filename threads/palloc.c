@@ -11,6 +11,7 @@
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "intrinsic.h"
 
 /* Page allocator.  Hands out memory in page-size (or
    page-multiple) chunks.  See malloc.h for an allocator that
@@ -24,13 +25,69 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is a binary buddy allocator.  Free memory is kept in
+   blocks of 2**ORDER pages, for ORDER from 0 to BUDDY_MAX_ORDER,
+   each aligned to its own size in physical memory, on one free
+   list per order.  A request is served from the smallest free
+   block big enough, splitting it in halves as needed, and the
+   pages past the end of the request are given back.  A freed
+   block merges with its "buddy", the other half of the block
+   twice its size, as long as the buddy is free too.  Both take
+   O(BUDDY_MAX_ORDER) steps however fragmented the pool.
+
+   orders[] records, for each page that heads a free block, the
+   block's order, and BUDDY_NOT_FREE for every other page, and
+   links[] holds the free list element of each page.  Keeping
+   both outside the pages means free memory is never written,
+   which palloc_init() relies on since it runs before all of RAM
+   is mapped.  Unless NDEBUG is defined, used_map shadows the
+   allocation state of every page, to catch double frees.
+
+   tags[] holds a byte per page for the use of whoever allocated
+   the page, through palloc_set_tag() and palloc_get_tag().  It
+   is 0 for a newly allocated page.
+
+   Since buddy operations are short, a pool is protected by a
+   spin lock, and pages may be freed with interrupts off, as
+   do_schedule() does with the pages of dead threads.
+
+   Each pool also keeps a stack of up to zeroed_max pages that are
+   already filled with zeros, which the idle thread refills
+   through palloc_zero_idle().  A single-page PAL_ZERO request
+   takes one of them instead of zeroing a page itself, and falls
+   back to memset() when there are none.  The pages count as
+   allocated, linked through links[], and go back to the buddy
+   lists if an allocation would fail without them. */
+
+#define BUDDY_MAX_ORDER 10              /* Largest block: 4 MB. */
+#define BUDDY_NOT_FREE 0xff             /* orders[] for other pages. */
+
+/* Most pre-zeroed pages a pool keeps, and the smallest share of
+   the pool they may take. */
+#define ZEROED_MAX 64
+#define ZEROED_SHARE 64
 
 /* A memory pool. */
 struct pool {
-	struct lock lock;               /* Mutual exclusion. */
-	struct bitmap *used_map;        /* Bitmap of free pages. */
+	struct spinlock lock;           /* Mutual exclusion. */
+	struct list free[BUDDY_MAX_ORDER + 1]; /* Free blocks, by order. */
+	uint8_t *orders;                /* Order of each free block. */
+	struct list_elem *links;        /* Free list element of each page. */
+	uint8_t *tags;                  /* Allocator's tag of each page. */
+	struct list zeroed;             /* Pages filled with zeros. */
+	size_t zeroed_cnt;              /* Number of pages on `zeroed'. */
+	size_t zeroed_max;              /* Most pages to keep on `zeroed'. */
+	size_t page_cnt;                /* Number of pages in pool. */
 	uint8_t *base;                  /* Base of pool. */
+#ifndef NDEBUG
+	struct bitmap *used_map;        /* Bitmap of free pages. */
+#endif
+
+	/* Statistics. */
+	uint64_t zero_hits;             /* PAL_ZERO pages from `zeroed'. */
+	uint64_t zero_misses;           /* PAL_ZERO pages zeroed inline. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -42,6 +99,11 @@ static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
+static struct list_elem *page_elem (const struct pool *, size_t page_idx);
+static void *zeroed_pop (struct pool *);
+static void zeroed_drain (struct pool *);
 
 /* multiboot info */
 struct multiboot_info {
@@ -219,16 +281,16 @@ split:
 			else
 				NOT_REACHED ();
 
-			pool_end = pool->base + bitmap_size (pool->used_map) * PGSIZE;
+			pool_end = pool->base + pool->page_cnt * PGSIZE;
 			page_idx = pg_no (start) - pg_no (pool->base);
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				buddy_free (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				buddy_free (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -256,18 +318,40 @@ palloc_init (void) {
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
    If PAL_USER is set, the pages are obtained from the user pool,
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
-   then the pages are filled with zeros.  If too few pages are
-   available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
+   then the pages are filled with zeros.  If PAGE_CNT is a power
+   of 2, the pages are aligned to PAGE_CNT * PGSIZE bytes.  If too
+   few pages are available, or PAGE_CNT exceeds 2**BUDDY_MAX_ORDER,
+   returns a null pointer, unless PAL_ASSERT is set in FLAGS, in
+   which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
+	enum intr_level old_level;
+	size_t page_idx;
 	void *pages;
 
+	old_level = spinlock_acquire (&pool->lock);
+	if ((flags & PAL_ZERO) && page_cnt == 1 && pool->zeroed_cnt > 0) {
+		pages = zeroed_pop (pool);
+		pool->zero_hits++;
+		spinlock_release (&pool->lock, old_level);
+		return pages;
+	}
+	page_idx = buddy_alloc (pool, page_cnt);
+	if (page_idx == BITMAP_ERROR && pool->zeroed_cnt > 0) {
+		zeroed_drain (pool);
+		page_idx = buddy_alloc (pool, page_cnt);
+	}
+	if ((flags & PAL_ZERO) && page_idx != BITMAP_ERROR)
+		pool->zero_misses++;
+#ifndef NDEBUG
+	if (page_idx != BITMAP_ERROR) {
+		ASSERT (bitmap_none (pool->used_map, page_idx, page_cnt));
+		bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+	}
+#endif
+	spinlock_release (&pool->lock, old_level);
+
 	if (page_idx != BITMAP_ERROR)
 		pages = pool->base + PGSIZE * page_idx;
 	else
@@ -299,6 +383,7 @@ palloc_get_page (enum palloc_flags flags) {
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) {
+	enum intr_level old_level;
 	struct pool *pool;
 	size_t page_idx;
 
@@ -318,8 +403,14 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
+	memset (pool->tags + page_idx, 0, page_cnt);
+	old_level = spinlock_acquire (&pool->lock);
+#ifndef NDEBUG
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
 	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+#endif
+	buddy_free (pool, page_idx, page_cnt);
+	spinlock_release (&pool->lock, old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -328,23 +419,120 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
-/* Initializes pool P as starting at START and ending at END */
+/* Zeroes a free page for a pool that is short of pre-zeroed
+   pages, kernel pool first, for later PAL_ZERO requests.  Meant
+   to be called by the idle thread, with interrupts on, since the
+   memset() is not interruptible otherwise.  Returns false if no
+   pool needs a page or none is free. */
+bool
+palloc_zero_idle (void) {
+	static struct pool *const pools[] = { &kernel_pool, &user_pool };
+
+	for (size_t i = 0; i < sizeof pools / sizeof *pools; i++) {
+		struct pool *pool = pools[i];
+		enum intr_level old_level;
+		size_t page_idx;
+		void *page;
+
+		if (pool->zeroed_cnt >= pool->zeroed_max)
+			continue;
+
+		old_level = spinlock_acquire (&pool->lock);
+		page_idx = buddy_alloc (pool, 1);
+#ifndef NDEBUG
+		if (page_idx != BITMAP_ERROR)
+			bitmap_mark (pool->used_map, page_idx);
+#endif
+		spinlock_release (&pool->lock, old_level);
+		if (page_idx == BITMAP_ERROR)
+			continue;
+
+		page = pool->base + PGSIZE * page_idx;
+		memset (page, 0, PGSIZE);
+
+		old_level = spinlock_acquire (&pool->lock);
+		list_push_front (&pool->zeroed, page_elem (pool, page_idx));
+		pool->zeroed_cnt++;
+		spinlock_release (&pool->lock, old_level);
+		return true;
+	}
+	return false;
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) {
+	printf ("palloc: PAL_ZERO pages pre-zeroed/zeroed inline: "
+			"kernel %"PRIu64"/%"PRIu64", user %"PRIu64"/%"PRIu64"\n",
+			kernel_pool.zero_hits, kernel_pool.zero_misses,
+			user_pool.zero_hits, user_pool.zero_misses);
+}
+
+/* Returns the pool that allocated PAGE. */
+static struct pool *
+page_to_pool (const void *page) {
+	if (page_from_pool (&kernel_pool, (void *) page))
+		return &kernel_pool;
+	else if (page_from_pool (&user_pool, (void *) page))
+		return &user_pool;
+	else
+		NOT_REACHED ();
+}
+
+/* Sets the tag of allocated PAGE to TAG. */
+void
+palloc_set_tag (void *page, uint8_t tag) {
+	struct pool *pool = page_to_pool (page);
+
+	pool->tags[pg_no (page) - pg_no (pool->base)] = tag;
+}
+
+/* Returns the tag of allocated PAGE, which may point anywhere
+   inside the page. */
+uint8_t
+palloc_get_tag (const void *page) {
+	struct pool *pool = page_to_pool (page);
+
+	return pool->tags[pg_no (page) - pg_no (pool->base)];
+}
+
+/* Initializes pool P as starting at START and ending at END,
+   with no free pages yet.  Its bookkeeping goes at *BM_BASE,
+   which is advanced past it. */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
-	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
-
-	lock_init(&p->lock);
-	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
+	size_t orders_bytes = ROUND_UP (pgcnt, PGSIZE);
+	size_t links_bytes = ROUND_UP (pgcnt * sizeof *p->links, PGSIZE);
+	size_t tags_bytes = ROUND_UP (pgcnt, PGSIZE);
+
+	spinlock_init (&p->lock);
+	for (int order = 0; order <= BUDDY_MAX_ORDER; order++)
+		list_init (&p->free[order]);
+	p->orders = *bm_base;
+	memset (p->orders, BUDDY_NOT_FREE, pgcnt);
+	p->page_cnt = pgcnt;
 	p->base = (void *) start;
+	*bm_base += orders_bytes;
+	p->links = *bm_base;
+	*bm_base += links_bytes;
+	p->tags = *bm_base;
+	memset (p->tags, 0, pgcnt);
+	*bm_base += tags_bytes;
+	list_init (&p->zeroed);
+	p->zeroed_cnt = 0;
+	p->zeroed_max = pgcnt / ZEROED_SHARE < ZEROED_MAX
+		? pgcnt / ZEROED_SHARE : ZEROED_MAX;
+	p->zero_hits = p->zero_misses = 0;
 
-	// Mark all to unusable.
-	bitmap_set_all(p->used_map, true);
-
-	*bm_base += bm_pages;
+#ifndef NDEBUG
+	/* Put the pool's used_map after the orders, marking every page
+	   in use until populate_pools() frees the usable ones. */
+	size_t bm_bytes = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_bytes);
+	bitmap_set_all (p->used_map, true);
+	*bm_base += bm_bytes;
+#endif
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -353,6 +541,115 @@ static bool
 page_from_pool (const struct pool *pool, void *page) {
 	size_t page_no = pg_no (page);
 	size_t start_page = pg_no (pool->base);
-	size_t end_page = start_page + bitmap_size (pool->used_map);
+	size_t end_page = start_page + pool->page_cnt;
 	return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the free list element of POOL's page PAGE_IDX. */
+static struct list_elem *
+page_elem (const struct pool *pool, size_t page_idx) {
+	return &pool->links[page_idx];
+}
+
+/* Puts the block of 2**ORDER pages at POOL's page PAGE_IDX on its
+   free list, first merging it with its buddy for as long as the
+   buddy is free.  POOL's lock must be held. */
+static void
+buddy_free_block (struct pool *pool, size_t page_idx, int order) {
+	size_t base_pfn = pg_no (pool->base);
+	size_t pfn = base_pfn + page_idx;
+
+	while (order < BUDDY_MAX_ORDER) {
+		size_t buddy_pfn = pfn ^ ((size_t) 1 << order);
+		size_t buddy_idx = buddy_pfn - base_pfn;
+
+		if (buddy_pfn < base_pfn || buddy_idx >= pool->page_cnt
+				|| pool->orders[buddy_idx] != order)
+			break;
+		list_remove (page_elem (pool, buddy_idx));
+		pool->orders[buddy_idx] = BUDDY_NOT_FREE;
+		pfn &= ~((size_t) 1 << order);
+		order++;
+	}
+
+	page_idx = pfn - base_pfn;
+	pool->orders[page_idx] = order;
+	list_push_front (&pool->free[order], page_elem (pool, page_idx));
+}
+
+/* Frees the PAGE_CNT pages from POOL's page PAGE_IDX on, as the
+   fewest blocks that are aligned to their sizes.  POOL's lock
+   must be held, except during initialization. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	size_t pfn = pg_no (pool->base) + page_idx;
+
+	while (page_cnt > 0) {
+		int order = bsrq (page_cnt);
+		if (order > BUDDY_MAX_ORDER)
+			order = BUDDY_MAX_ORDER;
+		if (pfn != 0 && (int) bsfq (pfn) < order)
+			order = bsfq (pfn);
+
+		buddy_free_block (pool, page_idx, order);
+		pfn += (size_t) 1 << order;
+		page_idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+	}
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first, or BITMAP_ERROR if there is no free block
+   big enough.  POOL's lock must be held. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt) {
+	int want, order;
+	size_t page_idx;
+
+	if (page_cnt == 0 || page_cnt > (size_t) 1 << BUDDY_MAX_ORDER)
+		return BITMAP_ERROR;
+	want = page_cnt == 1 ? 0 : bsrq (page_cnt - 1) + 1;
+
+	for (order = want; order <= BUDDY_MAX_ORDER; order++)
+		if (!list_empty (&pool->free[order]))
+			break;
+	if (order > BUDDY_MAX_ORDER)
+		return BITMAP_ERROR;
+
+	page_idx = list_pop_front (&pool->free[order]) - pool->links;
+	pool->orders[page_idx] = BUDDY_NOT_FREE;
+
+	/* Split off the upper halves we do not need. */
+	while (order > want) {
+		order--;
+		buddy_free_block (pool, page_idx + ((size_t) 1 << order), order);
+	}
+
+	/* Give back the pages past the end of the request. */
+	buddy_free (pool, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+	return page_idx;
+}
+
+/* Removes and returns a page from POOL's pre-zeroed pages, which
+   must not be empty.  POOL's lock must be held. */
+static void *
+zeroed_pop (struct pool *pool) {
+	struct list_elem *e = list_pop_front (&pool->zeroed);
+
+	pool->zeroed_cnt--;
+	return pool->base + PGSIZE * (size_t) (e - pool->links);
+}
+
+/* Returns all of POOL's pre-zeroed pages to its free lists.
+   POOL's lock must be held. */
+static void
+zeroed_drain (struct pool *pool) {
+	while (pool->zeroed_cnt > 0) {
+		size_t page_idx = pg_no (zeroed_pop (pool)) - pg_no (pool->base);
+
+#ifndef NDEBUG
+		bitmap_reset (pool->used_map, page_idx);
+#endif
+		buddy_free (pool, page_idx, 1);
+	}
+}
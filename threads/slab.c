@@ -0,0 +1,301 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator, after Bonwick, "The Slab Allocator: An
+   Object-Caching Kernel Memory Allocator", USENIX 1994.
+
+   Each cache carves its objects out of slabs of 2**K contiguous
+   pages.  A slab starts with a header holding a stack of the
+   indexes of its free objects, followed by the objects
+   themselves, so a free object is never written and keeps its
+   constructed state.  palloc aligns a block of 2**K pages to its
+   size, so the slab of an object is found by rounding its
+   address down.
+
+   A cache keeps its slabs that have free objects on a partial
+   list, allocating from the front of it, and its full slabs on a
+   full list.  A slab whose objects are all free goes to the back
+   of the partial list, and is returned to palloc if the cache
+   already holds SLAB_EMPTY_MAX such slabs. */
+
+/* Alignment of objects for caches that do not ask for one. */
+#define CACHE_LINE 64
+
+/* Smallest alignment of any object. */
+#define ALIGN_MIN 8
+
+/* Most pages in a slab. */
+#define SLAB_PAGES_MAX 8
+
+/* Most slabs with no objects in use a cache keeps. */
+#define SLAB_EMPTY_MAX 1
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* An object cache. */
+struct kmem_cache {
+	char name[16];              /* Name (for debugging purposes). */
+	size_t obj_size;            /* Object size, a multiple of ALIGN. */
+	size_t align;               /* Object alignment, a power of 2. */
+	kmem_ctor_func *ctor;       /* Constructor, or null. */
+	size_t slab_pages;          /* Pages per slab, a power of 2. */
+	size_t obj_cnt;             /* Objects per slab. */
+	size_t obj_ofs;             /* Offset of first object in a slab. */
+	struct kmem_cache *next;    /* Next in `caches'. */
+
+	struct lock lock;           /* Protects the fields below. */
+	struct list partial;        /* Slabs with free objects. */
+	struct list full;           /* Slabs with no free objects. */
+	size_t empty_cnt;           /* Slabs with no objects in use. */
+
+	/* Statistics. */
+	uint64_t alloc_cnt;         /* # of objects allocated. */
+	size_t in_use;              /* # of objects in use now. */
+	size_t slab_cnt;            /* # of slabs now. */
+};
+
+/* Slab header, at the start of the slab's first page. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;   /* Owning cache. */
+	struct list_elem elem;      /* Element in partial or full list. */
+	size_t free_cnt;            /* Number of free objects. */
+	uint16_t free[];            /* Indexes of free objects, a stack. */
+};
+
+/* All caches, most recently created first.  Protected by
+   disabling interrupts. */
+static struct kmem_cache *caches;
+
+static size_t slab_layout (size_t slab_bytes, size_t obj_size, size_t align,
+		size_t *obj_ofs);
+static struct slab *slab_create (struct kmem_cache *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *obj);
+
+/* Creates and returns a cache of objects SIZE bytes long, aligned
+   to ALIGN bytes, or to a cache line if ALIGN is 0, and named
+   NAME for statistics.  If CTOR is nonnull, it constructs each
+   object when its slab is created.  Returns a null pointer if
+   memory is not available. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, size_t align,
+		kmem_ctor_func *ctor) {
+	struct kmem_cache *cache;
+	enum intr_level old_level;
+	size_t pages, obj_cnt, obj_ofs;
+
+	ASSERT (name != NULL);
+	ASSERT (size > 0);
+	ASSERT (align <= PGSIZE && (align & (align - 1)) == 0);
+
+	/* Cache-line align by default, but let objects smaller than
+	   half a line share one, as long as none straddles a line. */
+	if (align == 0)
+		for (align = CACHE_LINE; align / 2 >= size && align > ALIGN_MIN; )
+			align /= 2;
+	if (align < ALIGN_MIN)
+		align = ALIGN_MIN;
+	size = ROUND_UP (size, align);
+
+	/* Use the smallest slab that wastes at most an eighth of its
+	   space on the header and the leftover tail. */
+	for (pages = 1; ; pages *= 2) {
+		size_t bytes = pages * PGSIZE;
+		obj_cnt = slab_layout (bytes, size, align, &obj_ofs);
+		if ((obj_cnt > 0 && bytes - obj_cnt * size <= bytes / 8)
+				|| pages == SLAB_PAGES_MAX)
+			break;
+	}
+	if (obj_cnt == 0)
+		return NULL;
+
+	cache = malloc (sizeof *cache);
+	if (cache == NULL)
+		return NULL;
+	strlcpy (cache->name, name, sizeof cache->name);
+	cache->obj_size = size;
+	cache->align = align;
+	cache->ctor = ctor;
+	cache->slab_pages = pages;
+	cache->obj_cnt = obj_cnt;
+	cache->obj_ofs = obj_ofs;
+	lock_init (&cache->lock);
+	list_init (&cache->partial);
+	list_init (&cache->full);
+	cache->empty_cnt = 0;
+	cache->alloc_cnt = 0;
+	cache->in_use = 0;
+	cache->slab_cnt = 0;
+
+	old_level = intr_disable ();
+	cache->next = caches;
+	caches = cache;
+	intr_set_level (old_level);
+
+	return cache;
+}
+
+/* Allocates and returns an object from CACHE, in its constructed
+   state.  Returns a null pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *cache) {
+	struct slab *slab;
+	void *obj;
+
+	lock_acquire (&cache->lock);
+	if (list_empty (&cache->partial)) {
+		slab = slab_create (cache);
+		if (slab == NULL) {
+			lock_release (&cache->lock);
+			return NULL;
+		}
+		list_push_front (&cache->partial, &slab->elem);
+		cache->empty_cnt++;
+	}
+
+	slab = list_entry (list_front (&cache->partial), struct slab, elem);
+	if (slab->free_cnt == cache->obj_cnt)
+		cache->empty_cnt--;
+	obj = (uint8_t *) slab + cache->obj_ofs
+		+ slab->free[--slab->free_cnt] * cache->obj_size;
+	if (slab->free_cnt == 0) {
+		list_remove (&slab->elem);
+		list_push_front (&cache->full, &slab->elem);
+	}
+
+	cache->alloc_cnt++;
+	cache->in_use++;
+	lock_release (&cache->lock);
+	return obj;
+}
+
+/* Returns OBJ, which must have been allocated from CACHE and be
+   back in its constructed state, to CACHE. */
+void
+kmem_cache_free (struct kmem_cache *cache, void *obj) {
+	struct slab *slab;
+	size_t idx;
+
+	if (obj == NULL)
+		return;
+
+	slab = obj_to_slab (cache, obj);
+	idx = ((uint8_t *) obj - ((uint8_t *) slab + cache->obj_ofs))
+		/ cache->obj_size;
+
+	lock_acquire (&cache->lock);
+	ASSERT (slab->free_cnt < cache->obj_cnt);
+	if (slab->free_cnt == 0) {
+		list_remove (&slab->elem);
+		list_push_front (&cache->partial, &slab->elem);
+	}
+	slab->free[slab->free_cnt++] = idx;
+	cache->in_use--;
+
+	/* If the slab is now entirely unused, keep it for later or
+	   give it back. */
+	if (slab->free_cnt == cache->obj_cnt) {
+		list_remove (&slab->elem);
+		if (cache->empty_cnt < SLAB_EMPTY_MAX) {
+			list_push_back (&cache->partial, &slab->elem);
+			cache->empty_cnt++;
+		} else {
+			cache->slab_cnt--;
+			slab->magic = 0;
+			palloc_free_multiple (slab, cache->slab_pages);
+		}
+	}
+	lock_release (&cache->lock);
+}
+
+/* Prints statistics for every cache. */
+void
+kmem_cache_print_stats (void) {
+	struct kmem_cache *cache;
+
+	if (caches == NULL)
+		return;
+
+	printf ("Slab caches:\n");
+	printf ("%-16s %6s %6s %6s %8s %12s\n", "name", "size", "per", "slabs",
+			"in-use", "allocs");
+	for (cache = caches; cache != NULL; cache = cache->next)
+		printf ("%-16s %6zu %6zu %6zu %8zu %12"PRIu64"\n", cache->name,
+				cache->obj_size, cache->obj_cnt, cache->slab_cnt,
+				cache->in_use, cache->alloc_cnt);
+}
+
+/* Returns the number of OBJ_SIZE-byte objects, aligned to ALIGN,
+   that fit in a slab of SLAB_BYTES after its header, and stores
+   the offset of the first object in *OBJ_OFS. */
+static size_t
+slab_layout (size_t slab_bytes, size_t obj_size, size_t align,
+		size_t *obj_ofs) {
+	size_t cnt = (slab_bytes - sizeof (struct slab))
+		/ (obj_size + sizeof ((struct slab *) 0)->free[0]);
+
+	for (; cnt > 0; cnt--) {
+		*obj_ofs = ROUND_UP (sizeof (struct slab)
+				+ cnt * sizeof ((struct slab *) 0)->free[0], align);
+		if (*obj_ofs + cnt * obj_size <= slab_bytes)
+			break;
+	}
+	return cnt;
+}
+
+/* Allocates a slab for CACHE and constructs all of its objects.
+   Returns a null pointer if memory is not available.  CACHE's
+   lock must be held. */
+static struct slab *
+slab_create (struct kmem_cache *cache) {
+	struct slab *slab;
+	size_t i;
+
+	slab = palloc_get_multiple (0, cache->slab_pages);
+	if (slab == NULL)
+		return NULL;
+	ASSERT ((uintptr_t) slab % (cache->slab_pages * PGSIZE) == 0);
+
+	slab->magic = SLAB_MAGIC;
+	slab->cache = cache;
+	slab->free_cnt = cache->obj_cnt;
+	for (i = 0; i < cache->obj_cnt; i++) {
+		/* Hand out the lowest objects first. */
+		slab->free[i] = cache->obj_cnt - 1 - i;
+		if (cache->ctor != NULL)
+			cache->ctor ((uint8_t *) slab + cache->obj_ofs
+					+ i * cache->obj_size);
+	}
+	cache->slab_cnt++;
+	return slab;
+}
+
+/* Returns the slab of CACHE that OBJ is inside. */
+static struct slab *
+obj_to_slab (struct kmem_cache *cache, void *obj) {
+	struct slab *slab = (struct slab *) ((uintptr_t) obj
+			& ~(cache->slab_pages * PGSIZE - 1));
+
+	/* Check that the slab is valid. */
+	ASSERT (slab->magic == SLAB_MAGIC);
+	ASSERT (slab->cache == cache);
+
+	/* Check that the object is properly aligned for the slab. */
+	ASSERT ((uint8_t *) obj >= (uint8_t *) slab + cache->obj_ofs);
+	ASSERT (((uint8_t *) obj - ((uint8_t *) slab + cache->obj_ofs))
+			% cache->obj_size == 0);
+
+	return slab;
+}
@@ -0,0 +1,96 @@
+#include "threads/softirq.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+
+/* Raised softirqs, oldest first.  Protected by disabling
+   interrupts. */
+static struct softirq *pending_head;
+static struct softirq *pending_tail;
+
+/* True while softirq_run() is running softirqs.  An interrupt
+   that arrives meanwhile leaves the softirqs it raises to that
+   run instead of starting a nested one. */
+static bool running;
+
+/* Statistics. */
+static uint64_t softirq_cnt;    /* # of softirqs run. */
+
+/* Initializes SOFTIRQ to run FUNC, passing AUX, when raised. */
+void
+softirq_init (struct softirq *softirq, softirq_func *func, void *aux) {
+	ASSERT (softirq != NULL);
+	ASSERT (func != NULL);
+
+	softirq->next = NULL;
+	softirq->func = func;
+	softirq->aux = aux;
+	softirq->pending = false;
+}
+
+/* Marks SOFTIRQ to run on return from the current interrupt, or
+   from the current softirq run.  Raising a softirq that is
+   already pending does nothing, so it runs once however many
+   times it was raised. */
+void
+softirq_raise (struct softirq *softirq) {
+	enum intr_level old_level;
+
+	ASSERT (intr_context () || softirq_context ());
+
+	old_level = intr_disable ();
+	if (!softirq->pending) {
+		softirq->pending = true;
+		softirq->next = NULL;
+		if (pending_tail != NULL)
+			pending_tail->next = softirq;
+		else
+			pending_head = softirq;
+		pending_tail = softirq;
+	}
+	intr_set_level (old_level);
+}
+
+/* Runs the pending softirqs, including any raised while they
+   run.  Called by the interrupt handler with interrupts off, at
+   the end of an external interrupt; enables interrupts around
+   each softirq and returns with them off again. */
+void
+softirq_run (void) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (!intr_context ());
+
+	if (running)
+		return;
+
+	running = true;
+	while (pending_head != NULL) {
+		struct softirq *softirq = pending_head;
+
+		pending_head = softirq->next;
+		if (pending_head == NULL)
+			pending_tail = NULL;
+		softirq->pending = false;
+		softirq_cnt++;
+
+		intr_enable ();
+		softirq->func (softirq->aux);
+		intr_disable ();
+	}
+	running = false;
+}
+
+/* Returns true while a softirq is running, false at all other
+   times. */
+bool
+softirq_context (void) {
+	return running;
+}
+
+/* Prints softirq statistics. */
+void
+softirq_print_stats (void) {
+	printf ("Softirq: %"PRIu64" softirqs run\n", softirq_cnt);
+}
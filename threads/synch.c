@@ -30,7 +30,16 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
+#include "threads/softirq.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "intrinsic.h"
+
+static bool waiter_less (const struct pheap_elem *, const struct pheap_elem *,
+		void *aux);
+static void waiter_push (struct pheap *);
+static struct thread *waiter_pop (struct pheap *);
+static void preempt_for (struct thread *, enum intr_level);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -40,13 +49,21 @@
    decrement it.
 
    - up or "V": increment the value (and wake up one waiting
-   thread, if any). */
+   thread, if any).
+
+   CLASS is the semaphore's lock profiling class.  The sema_init()
+   macro supplies one per call site. */
 void
-sema_init (struct semaphore *sema, unsigned value) {
+sema_init_class (struct semaphore *sema, unsigned value,
+		struct lock_class *class) {
 	ASSERT (sema != NULL);
+	ASSERT (class != NULL);
 
 	sema->value = value;
-	list_init (&sema->waiters);
+	pheap_init (&sema->waiters, waiter_less, NULL);
+	sema->class = class;
+	if (!class->registered)
+		lockstat_register (class);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -60,16 +77,25 @@ sema_init (struct semaphore *sema, unsigned value) {
 void
 sema_down (struct semaphore *sema) {
 	enum intr_level old_level;
+	bool contended;
+	uint64_t start = 0;
 
 	ASSERT (sema != NULL);
 	ASSERT (!intr_context ());
 
+	trace_event (TRACE_SEMA_DOWN, thread_tid (), sema);
 	old_level = intr_disable ();
+	contended = sema->value == 0;
+	if (lockstat_enabled && contended)
+		start = rdtsc ();
 	while (sema->value == 0) {
-		list_push_back (&sema->waiters, &thread_current ()->elem);
+		waiter_push (&sema->waiters);
 		thread_block ();
 	}
 	sema->value--;
+	if (lockstat_enabled)
+		lockstat_acquired (sema->class, contended ? rdtsc () - start : 0,
+				contended);
 	intr_set_level (old_level);
 }
 
@@ -90,6 +116,8 @@ sema_try_down (struct semaphore *sema) {
 	{
 		sema->value--;
 		success = true;
+		if (lockstat_enabled)
+			lockstat_acquired (sema->class, 0, false);
 	}
 	else
 		success = false;
@@ -99,21 +127,77 @@ sema_try_down (struct semaphore *sema) {
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest priority thread of those waiting for
+   SEMA, if any, yielding to it if it outranks the running
+   thread.
 
    This function may be called from an interrupt handler. */
 void
 sema_up (struct semaphore *sema) {
 	enum intr_level old_level;
+	struct thread *t = NULL;
 
 	ASSERT (sema != NULL);
 
+	trace_event (TRACE_SEMA_UP, thread_tid (), sema);
 	old_level = intr_disable ();
-	if (!list_empty (&sema->waiters))
-		thread_unblock (list_entry (list_pop_front (&sema->waiters),
-					struct thread, elem));
+	if (!pheap_empty (&sema->waiters)) {
+		t = waiter_pop (&sema->waiters);
+		thread_unblock (t);
+	}
 	sema->value++;
 	intr_set_level (old_level);
+	preempt_for (t, old_level);
+}
+
+/* Returns true if the thread waiting on A ranks below the one
+   waiting on B. */
+static bool
+waiter_less (const struct pheap_elem *a_, const struct pheap_elem *b_,
+		void *aux UNUSED) {
+	const struct thread *a = pheap_entry (a_, struct thread, waitelem);
+	const struct thread *b = pheap_entry (b_, struct thread, waitelem);
+
+	return thread_outranks (b, a);
+}
+
+/* Adds the running thread to waiter heap H, where the scheduler
+   can re-key it if its priority changes.  Interrupts must be
+   off. */
+static void
+waiter_push (struct pheap *h) {
+	struct thread *t = thread_current ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	pheap_push (h, &t->waitelem);
+	t->wait_heap = h;
+}
+
+/* Removes and returns the highest priority thread in waiter
+   heap H, which must not be empty.  Interrupts must be off. */
+static struct thread *
+waiter_pop (struct pheap *h) {
+	struct thread *t = pheap_entry (pheap_pop (h), struct thread, waitelem);
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	t->wait_heap = NULL;
+	return t;
+}
+
+/* Yields the CPU if T, a thread just woken, outranks the running
+   thread.  OLD_LEVEL is the interrupt level the waker was called
+   with: a caller that had interrupts off is in the middle of
+   something that must not be interrupted by a yield. */
+static void
+preempt_for (struct thread *t, enum intr_level old_level) {
+	if (t == NULL || !thread_outranks (t, thread_current ()))
+		return;
+	if (intr_context () || softirq_context ())
+		intr_yield_on_return ();
+	else if (old_level == INTR_ON)
+		thread_yield ();
 }
 
 static void sema_test_helper (void *sema_);
@@ -165,13 +249,17 @@ sema_test_helper (void *sema_) {
    another one "up" it, but with a lock the same thread must both
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
-   instead of a lock. */
+   instead of a lock.
+
+   CLASS is the lock's profiling class.  The lock_init() macro
+   supplies one per call site. */
 void
-lock_init (struct lock *lock) {
+lock_init_class (struct lock *lock, struct lock_class *class) {
 	ASSERT (lock != NULL);
 
 	lock->holder = NULL;
-	sema_init (&lock->semaphore, 1);
+	lock->acquire_tsc = 0;
+	sema_init_class (&lock->semaphore, 1, class);
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -190,6 +278,9 @@ lock_acquire (struct lock *lock) {
 
 	sema_down (&lock->semaphore);
 	lock->holder = thread_current ();
+	if (lockstat_enabled)
+		lock->acquire_tsc = rdtsc ();
+	trace_event (TRACE_LOCK_ACQUIRE, lock->holder->tid, lock);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -206,8 +297,11 @@ lock_try_acquire (struct lock *lock) {
 	ASSERT (!lock_held_by_current_thread (lock));
 
 	success = sema_try_down (&lock->semaphore);
-	if (success)
+	if (success) {
 		lock->holder = thread_current ();
+		if (lockstat_enabled)
+			lock->acquire_tsc = rdtsc ();
+	}
 	return success;
 }
 
@@ -222,6 +316,14 @@ lock_release (struct lock *lock) {
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
 
+	if (lock->acquire_tsc != 0) {
+		enum intr_level old_level = intr_disable ();
+		if (lockstat_enabled)
+			lockstat_released (lock->semaphore.class,
+					rdtsc () - lock->acquire_tsc);
+		lock->acquire_tsc = 0;
+		intr_set_level (old_level);
+	}
 	lock->holder = NULL;
 	sema_up (&lock->semaphore);
 }
@@ -236,12 +338,6 @@ lock_held_by_current_thread (const struct lock *lock) {
 	return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
-struct semaphore_elem {
-	struct list_elem elem;              /* List element. */
-	struct semaphore semaphore;         /* This semaphore. */
-};
-
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -249,7 +345,7 @@ void
 cond_init (struct condition *cond) {
 	ASSERT (cond != NULL);
 
-	list_init (&cond->waiters);
+	pheap_init (&cond->waiters, waiter_less, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -274,22 +370,27 @@ cond_init (struct condition *cond) {
    we need to sleep. */
 void
 cond_wait (struct condition *cond, struct lock *lock) {
-	struct semaphore_elem waiter;
+	enum intr_level old_level;
 
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	sema_init (&waiter.semaphore, 0);
-	list_push_back (&cond->waiters, &waiter.elem);
+	/* Waiters sleep directly on COND's heap.  Interrupts stay off
+	   from joining the heap until blocking, so that a signal
+	   cannot slip in between. */
+	old_level = intr_disable ();
+	waiter_push (&cond->waiters);
 	lock_release (lock);
-	sema_down (&waiter.semaphore);
+	thread_block ();
+	intr_set_level (old_level);
 	lock_acquire (lock);
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
+   this function signals the highest priority one to wake up from
+   its wait.
    LOCK must be held before calling this function.
 
    An interrupt handler cannot acquire a lock, so it does not
@@ -302,9 +403,16 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED) {
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	if (!list_empty (&cond->waiters))
-		sema_up (&list_entry (list_pop_front (&cond->waiters),
-					struct semaphore_elem, elem)->semaphore);
+	enum intr_level old_level;
+	struct thread *t = NULL;
+
+	old_level = intr_disable ();
+	if (!pheap_empty (&cond->waiters)) {
+		t = waiter_pop (&cond->waiters);
+		thread_unblock (t);
+	}
+	intr_set_level (old_level);
+	preempt_for (t, old_level);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -318,6 +426,245 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 
-	while (!list_empty (&cond->waiters))
+	while (!pheap_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
+
+/* Initializes spin lock SL to the unlocked state. */
+void
+spinlock_init (struct spinlock *sl) {
+	ASSERT (sl != NULL);
+
+	sl->locked = 0;
+}
+
+/* Disables interrupts and acquires spin lock SL, busy-waiting
+   while another CPU holds it.  Returns the previous interrupt
+   level, to be passed to spinlock_release().  SL must not
+   already be held by this CPU. */
+enum intr_level
+spinlock_acquire (struct spinlock *sl) {
+	enum intr_level old_level;
+	int locked;
+
+	ASSERT (sl != NULL);
+
+	old_level = intr_disable ();
+	for (;;) {
+		/* `xchg' with a memory operand is implicitly locked.  See
+		   [IA32-v2b] "XCHG". */
+		locked = 1;
+		asm volatile ("xchgl %0, %1"
+				: "+r" (locked), "+m" (sl->locked) : : "memory");
+		if (!locked)
+			break;
+		while (sl->locked)
+			asm volatile ("pause");
+	}
+	return old_level;
+}
+
+/* Releases spin lock SL, which must be held by this CPU, and
+   restores the interrupt level OLD_LEVEL returned by
+   spinlock_acquire(). */
+void
+spinlock_release (struct spinlock *sl, enum intr_level old_level) {
+	ASSERT (sl != NULL);
+	ASSERT (sl->locked);
+
+	barrier ();
+	sl->locked = 0;
+	intr_set_level (old_level);
+}
+
+/* Initializes RW as an unheld reader-writer lock.  CLASS is its
+   lock profiling class.  The rwlock_init() macro supplies one
+   per call site. */
+void
+rwlock_init_class (struct rwlock *rw, struct lock_class *class) {
+	ASSERT (rw != NULL);
+	ASSERT (class != NULL);
+
+	rw->readers = 0;
+	rw->writer = NULL;
+	list_init (&rw->read_waiters);
+	pheap_init (&rw->write_waiters, waiter_less, NULL);
+	rw->class = class;
+	if (!class->registered)
+		lockstat_register (class);
+}
+
+/* Blocks the running thread, which the caller has put on one of
+   RW's waiter queues, until another thread hands it RW.  Counts
+   the acquisition for lock profiling.  Interrupts must be off. */
+static void
+rwlock_wait (struct rwlock *rw) {
+	uint64_t start = lockstat_enabled ? rdtsc () : 0;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	thread_block ();
+	if (lockstat_enabled && start != 0)
+		lockstat_acquired (rw->class, rdtsc () - start, true);
+}
+
+/* Hands RW to the highest priority waiting writer, if any, or
+   else to all waiting readers.  RW must be free.  Interrupts
+   must be off. */
+static void
+rwlock_handoff (struct rwlock *rw) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (rw->writer == NULL && rw->readers == 0);
+
+	if (!pheap_empty (&rw->write_waiters)) {
+		rw->writer = waiter_pop (&rw->write_waiters);
+		thread_unblock (rw->writer);
+	} else
+		while (!list_empty (&rw->read_waiters)) {
+			rw->readers++;
+			thread_unblock (list_entry (list_pop_front (&rw->read_waiters),
+						struct thread, elem));
+		}
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   waits for it.  The running thread must not hold RW for
+   writing.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_read_acquire (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (!rwlock_held_by_current_thread (rw));
+
+	old_level = intr_disable ();
+	if (rw->writer == NULL && pheap_empty (&rw->write_waiters)) {
+		rw->readers++;
+		if (lockstat_enabled)
+			lockstat_acquired (rw->class, 0, false);
+	} else {
+		list_push_back (&rw->read_waiters, &thread_current ()->elem);
+		rwlock_wait (rw);
+	}
+	intr_set_level (old_level);
+}
+
+/* Releases RW, which the running thread holds for reading. */
+void
+rwlock_read_release (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (rw->readers > 0);
+
+	old_level = intr_disable ();
+	if (--rw->readers == 0)
+		rwlock_handoff (rw);
+	intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping while anyone else holds it.
+   RW must not already be held by the running thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_write_acquire (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (!rwlock_held_by_current_thread (rw));
+
+	old_level = intr_disable ();
+	if (rw->writer == NULL && rw->readers == 0) {
+		rw->writer = thread_current ();
+		if (lockstat_enabled)
+			lockstat_acquired (rw->class, 0, false);
+	} else {
+		waiter_push (&rw->write_waiters);
+		rwlock_wait (rw);
+	}
+	ASSERT (rw->writer == thread_current ());
+	intr_set_level (old_level);
+}
+
+/* Releases RW, which the running thread holds for writing. */
+void
+rwlock_write_release (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (rwlock_held_by_current_thread (rw));
+
+	old_level = intr_disable ();
+	rw->writer = NULL;
+	rwlock_handoff (rw);
+	intr_set_level (old_level);
+}
+
+/* Returns true if the running thread holds RW for writing.
+   Readers are not tracked, so there is no reader equivalent. */
+bool
+rwlock_held_by_current_thread (const struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	return rw->writer == thread_current ();
+}
+
+/* Initializes sequence lock SL. */
+void
+seqlock_init (struct seqlock *sl) {
+	ASSERT (sl != NULL);
+
+	sl->seq = 0;
+	spinlock_init (&sl->lock);
+}
+
+/* Begins a read of the record protected by SL, waiting out any
+   update in progress on another CPU.  Returns the sequence
+   number to pass to seqlock_read_retry(). */
+unsigned
+seqlock_read_begin (const struct seqlock *sl) {
+	unsigned seq;
+
+	while ((seq = sl->seq) & 1)
+		asm volatile ("pause");
+	barrier ();
+	return seq;
+}
+
+/* Returns true if the record protected by SL changed since the
+   seqlock_read_begin() call that returned SEQ, in which case the
+   read must be retried. */
+bool
+seqlock_read_retry (const struct seqlock *sl, unsigned seq) {
+	barrier ();
+	return sl->seq != seq;
+}
+
+/* Begins an update of the record protected by SL.  Interrupts
+   are off until the matching seqlock_write_end(), which must be
+   passed the returned interrupt level, so that no reader on this
+   CPU can observe the update half done. */
+enum intr_level
+seqlock_write_begin (struct seqlock *sl) {
+	enum intr_level old_level = spinlock_acquire (&sl->lock);
+
+	sl->seq++;
+	barrier ();
+	return old_level;
+}
+
+/* Ends an update of the record protected by SL begun by
+   seqlock_write_begin(), which returned OLD_LEVEL. */
+void
+seqlock_write_end (struct seqlock *sl, enum intr_level old_level) {
+	barrier ();
+	sl->seq++;
+	spinlock_release (&sl->lock, old_level);
+}
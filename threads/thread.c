@@ -1,15 +1,21 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <random.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/softirq.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -24,16 +30,79 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-
-/* List of processes in sleep state */
-static struct list sleep_list;
-
-
-/* Idle thread. */
-static struct thread *idle_thread;
+/* A scheduling group's ready threads.  There is one FIFO list
+   per priority level.  Bit N of `bitmap' is set if and
+   only if queues[N] is nonempty, so the highest ready priority is
+   found with a single `bsr'. */
+struct group_rq {
+	struct list queues[PRI_MAX + 1]; /* Ready threads, by priority. */
+	uint64_t bitmap;                /* Nonempty queues. */
+	int cnt;                        /* # of threads in all queues. */
+	struct list_elem elem;          /* In runqueue's `groups' if cnt > 0. */
+	struct sched_group *group;      /* Group we belong to. */
+};
+
+/* A scheduling group: a process and the processes it forks, or
+   all kernel threads, sharing one CPU budget in proportion to
+   WEIGHT.  VRUNTIME is the CPU time the group has used, in units
+   of 1/GROUP_VRT_SCALE tick at GROUP_WEIGHT_DEFAULT, so that a
+   group of twice the weight advances half as fast.  The
+   scheduler runs the group with the least vruntime, and within
+   it the highest-priority thread, so however many threads a
+   group holds it gets no more than its share when others want
+   the CPU. */
+struct sched_group {
+	unsigned weight;                /* Relative CPU share. */
+	int64_t vruntime;               /* Weighted CPU time used. */
+	int thread_cnt;                 /* # of threads, unless root_group. */
+	struct group_rq rq;             /* Ready threads. */
+};
+
+#define GROUP_VRT_SCALE 1024    /* Vruntime units per default tick. */
+
+/* Group of the kernel threads, and of anyone who has not made
+   a group of their own. */
+static struct sched_group root_group;
+
+/* Scheduler state, protected by disabling interrupts, like the
+   rest of the scheduler while only one CPU runs it.
+
+   The run queue holds the processes in THREAD_READY state, that
+   is, processes that are ready to run but not actually running.
+   The ready threads are kept per scheduling group, and `groups'
+   lists the groups with any.  Ready threads of the EDF class are
+   kept apart in dl_queue, which is served first. */
+struct runqueue {
+	struct pheap dl_queue;          /* Ready EDF threads, by deadline. */
+	struct list groups;             /* Groups with ready threads. */
+	int cnt;                        /* # of threads in all queues. */
+	int64_t min_vruntime;           /* Vruntime of last group picked. */
+	struct thread *idle;            /* Idle thread. */
+	unsigned thread_ticks;          /* # of timer ticks since last yield. */
+	struct list destruction_req;    /* Thread destruction requests. */
+};
+
+static struct runqueue runqueue;
+
+/* List of all processes.  Processes are added to this list
+   when they are first scheduled and removed when they exit. */
+static struct list all_list;
+
+/* Hierarchical timing wheel of sleeping threads, as in the
+   classic Linux timer wheel.  Level L has WHEEL_SIZE slots, each
+   covering WHEEL_SIZE^L ticks; a thread whose wake time is within
+   WHEEL_SIZE^(L+1) ticks of wheel_clock sits on level L.  Each
+   time level 0 wraps, the next slot of level 1 is cascaded down
+   (and so on up the levels), so arming and expiring a sleeper
+   are both amortized O(1).  Bit N of sleep_wheel_map[L] is set
+   if and only if sleep_wheel[L][N] is nonempty. */
+#define WHEEL_BITS 6                    /* log2 of slots per level. */
+#define WHEEL_SIZE (1 << WHEEL_BITS)    /* Slots per level. */
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4                  /* Horizon: 2^24 ticks. */
+static struct list sleep_wheel[WHEEL_LEVELS][WHEEL_SIZE];
+static uint64_t sleep_wheel_map[WHEEL_LEVELS];
+static int64_t wheel_clock;     /* Next tick the wheel will expire. */
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
@@ -41,28 +110,66 @@ static struct thread *initial_thread;
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
-/* Thread destruction requests */
-static struct list destruction_req;
-
 /* Statistics. */
-static long long idle_ticks;    /* # of timer ticks spent idle. */
-static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
-static long long user_ticks;    /* # of timer ticks in user programs. */
+static uint64_t idle_cycles;    /* # of TSC cycles spent idle. */
+static uint64_t kernel_cycles;  /* # of TSC cycles in kernel mode. */
+static uint64_t user_cycles;    /* # of TSC cycles in user mode. */
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* MLFQS state.  Only the running thread's recent_cpu changes
+   between once-a-second decays, so each thread that is charged a
+   tick is put on mlfqs_dirty_list and only those threads have
+   their priority recomputed every MLFQS_PRI_PERIOD ticks. */
+#define MLFQS_PRI_PERIOD 4      /* Ticks between priority updates. */
+static fixed_t load_avg;        /* System load average. */
+static struct list mlfqs_dirty_list;
+static int64_t mlfqs_next_pri;  /* Next tick to update priorities. */
+static int64_t mlfqs_next_decay;/* Next tick to decay recent_cpu. */
+
+/* Earliest-deadline-first class.  A thread in this class is
+   promised DL_RUNTIME ticks of CPU in every DL_PERIOD ticks, by
+   DL_DEADLINE ticks into each period, ahead of all threads of the
+   priority classes.  To keep the promises satisfiable, admission
+   control caps the summed utilization runtime / period of all EDF
+   threads at DL_UTIL_MAX, and a thread that exhausts its budget is
+   throttled, that is, put to sleep until its next period. */
+#define DL_UTIL_ONE 1000000     /* Utilization of a whole CPU. */
+#define DL_UTIL_MAX (DL_UTIL_ONE / 100 * 95)
+static int64_t dl_util;         /* Utilization admitted so far. */
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static struct thread *ready_queue_pop (void);
+static int ready_queue_max_priority (void);
+static int ready_queue_cnt (void);
+static bool sleep_wheel_empty (void);
+static void sleep_wheel_insert (struct thread *);
+static int sleep_wheel_cascade (int level);
+static int64_t sleep_wheel_next (void);
+static void mlfqs_tick (void);
+static int mlfqs_priority (const struct thread *);
+static bool dl_less (const struct pheap_elem *, const struct pheap_elem *,
+		void *aux);
+static int64_t dl_utilization (const struct thread *);
+static void dl_replenish (struct thread *, int64_t now);
+static void dl_tick (struct thread *);
+static void group_init (struct sched_group *, unsigned weight);
+static void group_get (struct sched_group *);
+static void group_put (struct sched_group *);
+static void group_switch (struct sched_group *);
+static void mlfqs_update_priority (struct thread *);
 static void do_schedule(int status);
 static void schedule (void);
 static tid_t allocate_tid (void);
@@ -111,15 +218,25 @@ thread_init (void) {
 
 	/* Init the globla thread context */
 	lock_init (&tid_lock);
-	list_init (&ready_list);
-	list_init (&sleep_list);
-	list_init (&destruction_req);
+	pheap_init (&runqueue.dl_queue, dl_less, NULL);
+	list_init (&runqueue.groups);
+	list_init (&runqueue.destruction_req);
+	group_init (&root_group, GROUP_WEIGHT_DEFAULT);
+	list_init (&all_list);
+	list_init (&mlfqs_dirty_list);
+	mlfqs_next_pri = MLFQS_PRI_PERIOD;
+	mlfqs_next_decay = TIMER_FREQ;
+	for (int level = 0; level < WHEEL_LEVELS; level++)
+		for (int idx = 0; idx < WHEEL_SIZE; idx++)
+			list_init (&sleep_wheel[level][idx]);
 
 	/* Set up a thread structure for the running thread. */
 	initial_thread = running_thread ();
 	init_thread (initial_thread, "main", PRI_DEFAULT);
 	initial_thread->status = THREAD_RUNNING;
 	initial_thread->tid = allocate_tid ();
+	initial_thread->acct_tsc = rdtsc ();
+	initial_thread->group = &root_group;
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -134,7 +251,7 @@ thread_start (void) {
 	/* Start preemptive thread scheduling. */
 	intr_enable ();
 
-	/* Wait for the idle thread to initialize idle_thread. */
+	/* Wait for the idle thread to initialize runqueue.idle. */
 	sema_down (&idle_started);
 }
 
@@ -144,26 +261,57 @@ void
 thread_tick (void) {
 	struct thread *t = thread_current ();
 
-	/* Update statistics. */
-	if (t == idle_thread)
-		idle_ticks++;
-#ifdef USERPROG
-	else if (t->pml4 != NULL)
-		user_ticks++;
-#endif
-	else
-		kernel_ticks++;
+	if (t->dl_runtime > 0)
+		dl_tick (t);
+	else if (t != runqueue.idle)
+		t->group->vruntime += GROUP_VRT_SCALE * GROUP_WEIGHT_DEFAULT
+			/ t->group->weight;
+	if (thread_mlfqs)
+		mlfqs_tick ();
 
 	/* Enforce preemption. */
-	if (++thread_ticks >= TIME_SLICE)
+	if (++runqueue.thread_ticks >= TIME_SLICE)
 		intr_yield_on_return ();
 }
 
 /* Prints thread statistics. */
 void
 thread_print_stats (void) {
-	printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
-			idle_ticks, kernel_ticks, user_ticks);
+	thread_account (false);
+	printf ("Thread: %"PRIu64" idle cycles, %"PRIu64" kernel cycles, "
+			"%"PRIu64" user cycles\n", idle_cycles, kernel_cycles, user_cycles);
+}
+
+/* Charges the TSC cycles elapsed since T's last accounting point
+   to T, as user time if USER is true and as kernel time
+   otherwise, and makes NOW the new accounting point. */
+static void
+account (struct thread *t, bool user, uint64_t now) {
+	uint64_t delta = now - t->acct_tsc;
+
+	t->acct_tsc = now;
+	if (user) {
+		t->user_cycles += delta;
+		user_cycles += delta;
+	} else {
+		t->kernel_cycles += delta;
+		if (t == runqueue.idle)
+			idle_cycles += delta;
+		else
+			kernel_cycles += delta;
+	}
+}
+
+/* Charges the running thread for the time since its last
+   accounting point.  schedule() calls this on every switch; the
+   system call and interrupt entry paths call it with USER true
+   on entry from user mode and with USER false just before
+   returning there, so that the two modes are told apart. */
+void
+thread_account (bool user) {
+	enum intr_level old_level = intr_disable ();
+	account (thread_current (), user, rdtsc ());
+	intr_set_level (old_level);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -178,9 +326,8 @@ thread_print_stats (void) {
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   If the new thread's PRIORITY is higher than the caller's, the
+   caller yields so that the new thread runs immediately. */
 tid_t
 thread_create (const char *name, int priority,
 		thread_func *function, void *aux) {
@@ -198,6 +345,17 @@ thread_create (const char *name, int priority,
 	init_thread (t, name, priority);
 	tid = t->tid = allocate_tid ();
 
+	/* A new thread inherits its creator's MLFQS state, and under
+	   MLFQS the PRIORITY argument is ignored. */
+	t->nice = thread_current ()->nice;
+	t->recent_cpu = thread_current ()->recent_cpu;
+	if (thread_mlfqs && function != idle)
+		t->priority = mlfqs_priority (t);
+
+	/* It also joins its creator's scheduling group. */
+	t->group = thread_current ()->group;
+	group_get (t->group);
+
 	/* Call the kernel_thread if it scheduled.
 	 * Note) rdi is 1st argument, and rsi is 2nd argument. */
 	t->tf.rip = (uintptr_t) kernel_thread;
@@ -212,59 +370,176 @@ thread_create (const char *name, int priority,
 	/* Add to run queue. */
 	thread_unblock (t);
 
-	return tid;
-}
-
-/* if the current thread is not idle thread,
-	change the state of the caller thread to BLOCKED,
-	store the local tick to wake up,
-	update the global tick to wake up,
-	update the global tick if necessary,
-	and call schedule() */
-/* when you manipulate thread list, disable interrupt*/
-/* 비교 함수: 스레드의 wakeup_tick 값을 비교하여 정렬 순서를 결정합니다. */
-bool thread_wakeup_tick_less(const struct list_elem *a, const struct list_elem *b, void *aux) {
-    const struct thread *thread_a = list_entry(a, struct thread, elem);
-    const struct thread *thread_b = list_entry(b, struct thread, elem);
+	/* Preempt the caller if the new thread should run first. */
+	if (thread_outranks (t, thread_current ()))
+		thread_yield ();
 
-    return thread_a->wake_time < thread_b->wake_time;
+	return tid;
 }
 
+/* Puts the running thread to sleep until the timer reaches tick
+   WAKE_TIME.  The thread is armed on the sleep wheel and blocked;
+   thread_wake() unblocks it from the timer interrupt.  Does
+   nothing when called from the idle thread, which must never
+   block outside of idle(). */
 void
-thread_sleep(int64_t ticks) {
-	struct thread *curr=thread_current();
+thread_sleep (int64_t wake_time) {
+	struct thread *curr = thread_current ();
 	enum intr_level old_level;
 
 	ASSERT (!intr_context ());
-	
-	if (curr!=idle_thread){
-		old_level = intr_disable ();
-		curr -> wake_time = ticks;
-		list_push_back(&sleep_list, &curr->elem);
-		list_sort(&sleep_list, thread_wakeup_tick_less, curr->wake_time);
-		thread_block();
-		// do_schedule (THREAD_BLOCKED);
-		intr_set_level (old_level);	
-	}
+
+	if (curr == runqueue.idle)
+		return;
+
+	old_level = intr_disable ();
+	/* An empty wheel may lag far behind the timer.  Bring it up to
+	   date so that thread_wake() need not replay idle ticks. */
+	if (sleep_wheel_empty ())
+		wheel_clock = timer_ticks ();
+	curr->wake_time = wake_time;
+	sleep_wheel_insert (curr);
+	thread_block ();
+	intr_set_level (old_level);
 }
 
+/* Wakes every sleeping thread whose wake time is at most TICKS and
+   returns the tick at which thread_wake() must next be called, or
+   INT64_MAX if no thread is asleep.  Called from the timer
+   softirq with interrupts off, and returns with them off, but
+   lets interrupts in between wheel slots so that a long replay
+   does not hold them off throughout.
+
+   Each call replays the wheel one tick at a time from where the
+   previous call left off.  Because the returned tick is never
+   more than WHEEL_SIZE ticks ahead while any thread sleeps, the
+   replay is bounded by WHEEL_SIZE and the amortized cost of
+   expiring a sleeper is constant. */
 int64_t
-thread_wake(int64_t ticks){
-	for(struct list_elem *e = list_begin (&sleep_list); e != list_end (&sleep_list); e=list_next(e)){
-		struct thread * sleep = list_entry (e, struct thread, elem);
-		printf("%lld waketime %lld ticks\n",sleep->wake_time, ticks);
-		if(sleep->wake_time <= ticks){
-			enum intr_level old_level;
-			old_level = intr_disable ();
-			e=list_remove(e);
-			e=list_prev(e);
-			thread_unblock(sleep);
-			// do_schedule (THREAD_READY);
-			intr_set_level (old_level);	
+thread_wake (int64_t ticks) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (softirq_context ());
+
+	if (sleep_wheel_empty ()) {
+		wheel_clock = ticks + 1;
+		return INT64_MAX;
+	}
+
+	while (wheel_clock <= ticks) {
+		struct list *slot;
+		int idx = wheel_clock & WHEEL_MASK;
+
+		/* Entering a new lap of level 0: pull the next slot of each
+		   upper level down, stopping at the first level that has not
+		   wrapped as well. */
+		if (idx == 0)
+			for (int level = 1; level < WHEEL_LEVELS; level++)
+				if (sleep_wheel_cascade (level) != 0)
+					break;
+
+		slot = &sleep_wheel[0][idx];
+		sleep_wheel_map[0] &= ~(1ULL << idx);
+		wheel_clock++;
+		while (!list_empty (slot)) {
+			struct thread *t = list_entry (list_pop_front (slot),
+					struct thread, elem);
+			ASSERT (t->wake_time <= ticks);
+			thread_unblock (t);
+			if (thread_outranks (t, thread_current ()))
+				intr_yield_on_return ();
 		}
-		else
-			return sleep->wake_time;
+		intr_enable ();
+		intr_disable ();
+	}
+	return sleep_wheel_next ();
+}
+
+/* Returns true if no thread is armed on the sleep wheel. */
+static bool
+sleep_wheel_empty (void) {
+	for (int level = 0; level < WHEEL_LEVELS; level++)
+		if (sleep_wheel_map[level] != 0)
+			return false;
+	return true;
+}
+
+/* Arms sleeping thread T on the slot of the sleep wheel that
+   covers T's wake time relative to wheel_clock.  Wake times past
+   the wheel's horizon are clamped to the top level and simply
+   land there again each time their slot is cascaded, until they
+   come within range. */
+static void
+sleep_wheel_insert (struct thread *t) {
+	int64_t expires = t->wake_time;
+	int64_t delta;
+	int level, idx;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (expires < wheel_clock)
+		expires = wheel_clock;
+	delta = expires - wheel_clock;
+	if (delta >= 1LL << (WHEEL_BITS * WHEEL_LEVELS)) {
+		delta = (1LL << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+		expires = wheel_clock + delta;
+	}
+
+	for (level = 0; level < WHEEL_LEVELS - 1; level++)
+		if (delta < 1LL << (WHEEL_BITS * (level + 1)))
+			break;
+	idx = (expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+
+	list_push_back (&sleep_wheel[level][idx], &t->elem);
+	sleep_wheel_map[level] |= 1ULL << idx;
+}
+
+/* Re-arms every thread in the current slot of LEVEL on the lower
+   levels, and returns that slot's index.  A return value of 0
+   means LEVEL has wrapped too, so the next level up must be
+   cascaded as well. */
+static int
+sleep_wheel_cascade (int level) {
+	int idx = (wheel_clock >> (WHEEL_BITS * level)) & WHEEL_MASK;
+	struct list *slot = &sleep_wheel[level][idx];
+	struct list pending;
+
+	/* Detach the slot first: a re-armed thread may land in the
+	   very slot that is being emptied. */
+	list_init (&pending);
+	while (!list_empty (slot))
+		list_push_back (&pending, list_pop_front (slot));
+	sleep_wheel_map[level] &= ~(1ULL << idx);
+
+	while (!list_empty (&pending))
+		sleep_wheel_insert (list_entry (list_pop_front (&pending),
+					struct thread, elem));
+	return idx;
+}
+
+/* Returns the next tick at which the sleep wheel needs service.
+   Level-0 slots hold exact wake times, so the first occupied slot
+   at or after wheel_clock is a candidate.  If any upper level is
+   occupied, the wheel must also be serviced at the start of the
+   next level-0 lap to cascade it, which may come first: a level-0
+   slot behind wheel_clock's index belongs to the next lap. */
+static int64_t
+sleep_wheel_next (void) {
+	uint64_t map = sleep_wheel_map[0];
+	int cur = wheel_clock & WHEEL_MASK;
+	int64_t next = INT64_MAX;
+
+	if (map != 0) {
+		uint64_t rotated = cur ? (map >> cur) | (map << (WHEEL_SIZE - cur)) : map;
+		next = wheel_clock + bsfq (rotated);
 	}
+	for (int level = 1; level < WHEEL_LEVELS; level++)
+		if (sleep_wheel_map[level] != 0) {
+			int64_t lap = ROUND_UP (wheel_clock, WHEEL_SIZE);
+			if (lap < next)
+				next = lap;
+			break;
+		}
+	return next;
 }
 
 /* Puts the current thread to sleep.  It will not be scheduled
@@ -276,7 +551,9 @@ thread_wake(int64_t ticks){
 void
 thread_block (void) {
 	ASSERT (!intr_context ());
+	ASSERT (!softirq_context ());
 	ASSERT (intr_get_level () == INTR_OFF);
+	trace_event (TRACE_BLOCK, thread_current ()->tid, 0);
 	thread_current ()->status = THREAD_BLOCKED;
 	schedule ();
 }
@@ -297,8 +574,17 @@ thread_unblock (struct thread *t) {
 
 	old_level = intr_disable ();
 	ASSERT (t->status == THREAD_BLOCKED);
-	list_push_back (&ready_list, &t->elem);
+
+	/* An EDF thread waking up in a later period than it blocked
+	   in, including a throttled one, starts that period afresh. */
+	if (t->dl_runtime > 0) {
+		int64_t now = timer_ticks ();
+		if (now >= t->dl_next_period)
+			dl_replenish (t, now);
+	}
+	ready_queue_push (t);
 	t->status = THREAD_READY;
+	trace_event (TRACE_WAKEUP, t->tid, running_thread ()->tid);
 	intr_set_level (old_level);
 }
 
@@ -341,10 +627,16 @@ thread_exit (void) {
 #ifdef USERPROG
 	process_exit ();
 #endif
+	group_get (&root_group);
+	group_switch (&root_group);
 
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
 	intr_disable ();
+	dl_util -= dl_utilization (thread_current ());
+	list_remove (&thread_current ()->allelem);
+	if (thread_current ()->dirty)
+		list_remove (&thread_current ()->dirty_elem);
 	do_schedule (THREAD_DYING);
 	NOT_REACHED ();
 }
@@ -359,16 +651,42 @@ thread_yield (void) {
 	ASSERT (!intr_context ());
 
 	old_level = intr_disable ();
-	if (curr != idle_thread)
-		list_push_back (&ready_list, &curr->elem);
+	if (curr->dl_throttled) {
+		/* Out of EDF budget: sit out the rest of the period. */
+		int64_t now = timer_ticks ();
+		if (now < curr->dl_next_period) {
+			timer_sleep_until (curr->dl_next_period);
+			intr_set_level (old_level);
+			return;
+		}
+		dl_replenish (curr, now);
+	}
+	if (curr != runqueue.idle)
+		ready_queue_push (curr);
 	do_schedule (THREAD_READY);
 	intr_set_level (old_level);
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's priority to NEW_PRIORITY, and
+   yields if some ready thread now has a higher priority.
+   Ignored under MLFQS, which computes priorities itself. */
 void
 thread_set_priority (int new_priority) {
+	enum intr_level old_level;
+	bool preempt;
+
+	ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+	if (thread_mlfqs)
+		return;
+
+	old_level = intr_disable ();
 	thread_current ()->priority = new_priority;
+	preempt = ready_queue_max_priority () > new_priority;
+	intr_set_level (old_level);
+
+	if (preempt)
+		thread_yield ();
 }
 
 /* Returns the current thread's priority. */
@@ -377,38 +695,349 @@ thread_get_priority (void) {
 	return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Returns true if thread A should run before thread B: if A is of
+   the EDF class and B is not, if both are and A has the earlier
+   deadline, or if neither is and A has the higher priority. */
+bool
+thread_outranks (const struct thread *a, const struct thread *b) {
+	bool a_dl = a->dl_runtime > 0;
+	bool b_dl = b->dl_runtime > 0;
+
+	if (a_dl != b_dl)
+		return a_dl;
+	if (a_dl)
+		return a->dl_abs_deadline < b->dl_abs_deadline;
+	return a->priority > b->priority;
+}
+
+/* Moves the running thread into the EDF class, to get RUNTIME
+   ticks of CPU by DEADLINE ticks into every PERIOD ticks, the
+   first period starting now.  Requires 0 < RUNTIME <= DEADLINE
+   <= PERIOD.  Returns false, changing nothing, if the parameters
+   are invalid or admitting the thread would overcommit the CPU.
+   A RUNTIME of 0 returns the thread to its priority class. */
+bool
+thread_set_deadline (int64_t runtime, int64_t deadline, int64_t period) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	int64_t util;
+	bool success = false;
+	bool preempt = false;
+
+	if (runtime == 0)
+		deadline = period = 1;
+	else if (runtime < 0 || runtime > deadline || deadline > period)
+		return false;
+	util = runtime * DL_UTIL_ONE / period;
+
+	old_level = intr_disable ();
+	if (dl_util - dl_utilization (curr) + util <= DL_UTIL_MAX) {
+		dl_util += util - dl_utilization (curr);
+		curr->dl_runtime = runtime;
+		curr->dl_deadline = deadline;
+		curr->dl_period = period;
+		curr->dl_throttled = false;
+		if (runtime > 0)
+			dl_replenish (curr, timer_ticks ());
+		else
+			/* Leaving the EDF class may leave us outranked. */
+			preempt = !pheap_empty (&runqueue.dl_queue)
+				|| ready_queue_max_priority () > curr->priority;
+		success = true;
+	}
+	intr_set_level (old_level);
+
+	if (preempt)
+		thread_yield ();
+	return success;
+}
+
+/* Returns true if EDF thread A has a later deadline than B. */
+static bool
+dl_less (const struct pheap_elem *a_, const struct pheap_elem *b_,
+		void *aux UNUSED) {
+	const struct thread *a = pheap_entry (a_, struct thread, waitelem);
+	const struct thread *b = pheap_entry (b_, struct thread, waitelem);
+
+	return a->dl_abs_deadline > b->dl_abs_deadline;
+}
+
+/* Returns the share of a CPU, in DL_UTIL_ONE units, admitted for
+   T, or 0 if T is not of the EDF class. */
+static int64_t
+dl_utilization (const struct thread *t) {
+	return t->dl_runtime > 0 ? t->dl_runtime * DL_UTIL_ONE / t->dl_period : 0;
+}
+
+/* Starts a new period of EDF thread T at tick NOW, with a full
+   budget.  Interrupts must be off. */
+static void
+dl_replenish (struct thread *t, int64_t now) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	t->dl_abs_deadline = now + t->dl_deadline;
+	t->dl_next_period = now + t->dl_period;
+	t->dl_budget = t->dl_runtime;
+	t->dl_throttled = false;
+}
+
+/* Charges the tick that just ended to T, the running EDF thread.
+   Starts T's next period if it has come, and otherwise throttles
+   T if its budget is spent.  Called from thread_tick(). */
+static void
+dl_tick (struct thread *t) {
+	int64_t now = timer_ticks ();
+
+	t->dl_budget--;
+	if (now >= t->dl_next_period)
+		dl_replenish (t, now);
+	else if (t->dl_budget <= 0) {
+		t->dl_throttled = true;
+		intr_yield_on_return ();
+	}
+}
+
+/* Moves the running thread into a new scheduling group of the
+   given WEIGHT, between GROUP_WEIGHT_MIN and GROUP_WEIGHT_MAX.
+   Threads it creates from now on join the new group too.
+   Returns false, changing nothing, if memory is exhausted. */
+bool
+thread_group_new (unsigned weight) {
+	struct sched_group *group;
+
+	ASSERT (!intr_context ());
+	ASSERT (GROUP_WEIGHT_MIN <= weight && weight <= GROUP_WEIGHT_MAX);
+
+	group = malloc (sizeof *group);
+	if (group == NULL)
+		return false;
+	group_init (group, weight);
+	group->thread_cnt = 1;
+	group_switch (group);
+	return true;
+}
+
+/* Sets the weight of the running thread's scheduling group to
+   WEIGHT, between GROUP_WEIGHT_MIN and GROUP_WEIGHT_MAX. */
 void
-thread_set_nice (int nice UNUSED) {
-	/* TODO: Your implementation goes here */
+thread_group_set_weight (unsigned weight) {
+	ASSERT (GROUP_WEIGHT_MIN <= weight && weight <= GROUP_WEIGHT_MAX);
+
+	thread_current ()->group->weight = weight;
+}
+
+/* Returns the weight of the running thread's scheduling group. */
+unsigned
+thread_group_get_weight (void) {
+	return thread_current ()->group->weight;
+}
+
+/* Initializes GROUP as an empty group of WEIGHT. */
+static void
+group_init (struct sched_group *group, unsigned weight) {
+	group->weight = weight;
+	group->vruntime = 0;
+	group->thread_cnt = 0;
+	for (int pri = PRI_MIN; pri <= PRI_MAX; pri++)
+		list_init (&group->rq.queues[pri]);
+	group->rq.bitmap = 0;
+	group->rq.cnt = 0;
+	group->rq.group = group;
+}
+
+/* Adds a thread to GROUP. */
+static void
+group_get (struct sched_group *group) {
+	if (group != &root_group)
+		__atomic_add_fetch (&group->thread_cnt, 1, __ATOMIC_RELAXED);
+}
+
+/* Removes a thread from GROUP, freeing GROUP if it was the last.
+   Only a group without threads can have none ready, so no run
+   queue still refers to it. */
+static void
+group_put (struct sched_group *group) {
+	if (group != &root_group
+			&& __atomic_sub_fetch (&group->thread_cnt, 1, __ATOMIC_ACQ_REL) == 0)
+		free (group);
+}
+
+/* Moves the running thread into GROUP, which the caller holds a
+   reference to on the thread's behalf, and drops the thread from
+   its old group.  A group that joins the competition starts from
+   the run queue's min_vruntime, rather than with a credit. */
+static void
+group_switch (struct sched_group *group) {
+	struct thread *curr = thread_current ();
+	struct sched_group *old;
+	enum intr_level old_level;
+
+	ASSERT (!intr_context ());
+
+	old_level = intr_disable ();
+	old = curr->group;
+	if (group->vruntime < runqueue.min_vruntime)
+		group->vruntime = runqueue.min_vruntime;
+	curr->group = group;
+	intr_set_level (old_level);
+
+	group_put (old);
+}
+
+/* Sets the current thread's nice value to NICE.  Under the
+   MLFQS, also recomputes its priority, and yields if it no longer
+   has the highest priority; the priority scheduler only records
+   NICE. */
+void
+thread_set_nice (int nice) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	bool preempt = false;
+
+	ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+	old_level = intr_disable ();
+	curr->nice = nice;
+	if (thread_mlfqs) {
+		mlfqs_update_priority (curr);
+		preempt = ready_queue_max_priority () > curr->priority;
+	}
+	intr_set_level (old_level);
+
+	if (preempt)
+		thread_yield ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int load_avg_100 = fp_round (fp_mul_int (load_avg, 100));
+	intr_set_level (old_level);
+	return load_avg_100;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int recent_cpu_100 = fp_round (fp_mul_int (thread_current ()->recent_cpu,
+				100));
+	intr_set_level (old_level);
+	return recent_cpu_100;
+}
+
+/* Returns the MLFQS priority of T, computed from its recent_cpu
+   and nice values. */
+static int
+mlfqs_priority (const struct thread *t) {
+	int priority = PRI_MAX - fp_to_int (fp_div_int (t->recent_cpu, 4))
+		- t->nice * 2;
+
+	if (priority < PRI_MIN)
+		return PRI_MIN;
+	if (priority > PRI_MAX)
+		return PRI_MAX;
+	return priority;
+}
+
+/* Recomputes T's MLFQS priority, moving T to its new run queue if
+   it is ready.  Interrupts must be off. */
+static void
+mlfqs_update_priority (struct thread *t) {
+	int priority;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (t == runqueue.idle)
+		return;
+
+	priority = mlfqs_priority (t);
+	if (priority == t->priority)
+		return;
+	if (t->status == THREAD_READY) {
+		ready_queue_remove (t);
+		t->priority = priority;
+		ready_queue_push (t);
+	} else {
+		t->priority = priority;
+		/* Re-key T if it waits on a semaphore, condition or lock. */
+		if (t->wait_heap != NULL)
+			pheap_update (t->wait_heap, &t->waitelem);
+	}
+}
+
+/* MLFQS bookkeeping for one timer tick, called from
+   thread_tick().  Charges the tick to the running thread, decays
+   every thread's recent_cpu and the load average once per second,
+   and every MLFQS_PRI_PERIOD ticks recomputes the priority of the
+   threads whose recent_cpu changed.  Loops rather than tests for
+   equality so that ticks skipped in tickless idle are replayed. */
+static void
+mlfqs_tick (void) {
+	struct thread *curr = thread_current ();
+	struct thread *idle_thread = runqueue.idle;
+	int64_t now = timer_ticks ();
+	struct list_elem *e;
+
+	if (curr != idle_thread) {
+		curr->recent_cpu = fp_add_int (curr->recent_cpu, 1);
+		if (!curr->dirty) {
+			curr->dirty = true;
+			list_push_back (&mlfqs_dirty_list, &curr->dirty_elem);
+		}
+	}
+
+	while (now >= mlfqs_next_decay) {
+		int ready_threads = ready_queue_cnt () + (curr != idle_thread ? 1 : 0);
+
+		/* load_avg = (59/60) * load_avg + (1/60) * ready_threads. */
+		load_avg = fp_div_int (fp_add_int (fp_mul_int (load_avg, 59),
+					ready_threads), 60);
+
+		/* recent_cpu = (2 * load_avg) / (2 * load_avg + 1)
+		                * recent_cpu + nice. */
+		fixed_t twice_load = fp_mul_int (load_avg, 2);
+		fixed_t coef = fp_div (twice_load, fp_add_int (twice_load, 1));
+		for (e = list_begin (&all_list); e != list_end (&all_list);
+				e = list_next (e)) {
+			struct thread *t = list_entry (e, struct thread, allelem);
+			if (t == idle_thread)
+				continue;
+			t->recent_cpu = fp_add_int (fp_mul (coef, t->recent_cpu), t->nice);
+			if (!t->dirty) {
+				t->dirty = true;
+				list_push_back (&mlfqs_dirty_list, &t->dirty_elem);
+			}
+		}
+		mlfqs_next_decay += TIMER_FREQ;
+	}
+
+	if (now >= mlfqs_next_pri) {
+		while (!list_empty (&mlfqs_dirty_list)) {
+			struct thread *t = list_entry (list_pop_front (&mlfqs_dirty_list),
+					struct thread, dirty_elem);
+			t->dirty = false;
+			mlfqs_update_priority (t);
+		}
+		mlfqs_next_pri = now - now % MLFQS_PRI_PERIOD + MLFQS_PRI_PERIOD;
+
+		if (ready_queue_max_priority () > curr->priority)
+			intr_yield_on_return ();
+	}
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
 
    The idle thread is initially put on the ready list by
    thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
+   point it initializes runqueue.idle, "up"s the semaphore passed
    to it to enable thread_start() to continue, and immediately
    blocks.  After that, the idle thread never appears in the
    ready list.  It is returned by next_thread_to_run() as a
@@ -417,14 +1046,25 @@ static void
 idle (void *idle_started_ UNUSED) {
 	struct semaphore *idle_started = idle_started_;
 
-	idle_thread = thread_current ();
+	runqueue.idle = thread_current ();
 	sema_up (idle_started);
 
 	for (;;) {
-		/* Let someone else run. */
+		/* Zero free pages for PAL_ZERO requests, thread pages
+		   included, while there is nothing better to do.  A
+		   thread woken meanwhile preempts us. */
+		while (palloc_zero_idle ())
+			continue;
+
+		/* Let someone else run.  The interrupt that ended the
+		   last halt already restarted the periodic tick. */
 		intr_disable ();
 		thread_block ();
 
+		/* Nothing else is runnable: stop the periodic tick, if
+		   tickless mode is on. */
+		timer_idle_enter ();
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -456,6 +1096,8 @@ kernel_thread (thread_func *function, void *aux) {
    NAME. */
 static void
 init_thread (struct thread *t, const char *name, int priority) {
+	enum intr_level old_level;
+
 	ASSERT (t != NULL);
 	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
 	ASSERT (name != NULL);
@@ -465,7 +1107,109 @@ init_thread (struct thread *t, const char *name, int priority) {
 	strlcpy (t->name, name, sizeof t->name);
 	t->tf.rsp = (uint64_t) t + PGSIZE - sizeof (void *);
 	t->priority = priority;
+	t->nice = NICE_DEFAULT;
 	t->magic = THREAD_MAGIC;
+
+	old_level = intr_disable ();
+	list_push_back (&all_list, &t->allelem);
+	intr_set_level (old_level);
+}
+
+/* Appends T to the tail of the run queue for T's group and
+   priority.  Interrupts must be off. */
+static void
+ready_queue_push (struct thread *t) {
+	struct group_rq *grq = &t->group->rq;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+	if (t->dl_runtime > 0)
+		pheap_push (&runqueue.dl_queue, &t->waitelem);
+	else {
+		if (grq->cnt++ == 0) {
+			/* A group that has been idle gets no credit for it. */
+			list_push_back (&runqueue.groups, &grq->elem);
+			if (t->group->vruntime < runqueue.min_vruntime)
+				t->group->vruntime = runqueue.min_vruntime;
+		}
+		list_push_back (&grq->queues[t->priority], &t->elem);
+		grq->bitmap |= 1ULL << t->priority;
+	}
+	runqueue.cnt++;
+}
+
+/* Removes ready thread T from the run queue.
+   Interrupts must be off. */
+static void
+ready_queue_remove (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (t->status == THREAD_READY);
+
+	if (t->dl_runtime > 0)
+		pheap_remove (&runqueue.dl_queue, &t->waitelem);
+	else {
+		struct group_rq *grq = &t->group->rq;
+		list_remove (&t->elem);
+		if (list_empty (&grq->queues[t->priority]))
+			grq->bitmap &= ~(1ULL << t->priority);
+		if (--grq->cnt == 0)
+			list_remove (&grq->elem);
+	}
+	runqueue.cnt--;
+}
+
+/* Removes and returns the EDF thread with the earliest deadline,
+   or if there is none the thread at the head of the highest
+   nonempty queue of the group with the least vruntime, or returns
+   a null pointer if the run queue is empty.  Interrupts must be
+   off. */
+static struct thread *
+ready_queue_pop (void) {
+	struct thread *t = NULL;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!pheap_empty (&runqueue.dl_queue)) {
+		t = pheap_entry (pheap_max (&runqueue.dl_queue), struct thread,
+				waitelem);
+		ready_queue_remove (t);
+	} else if (!list_empty (&runqueue.groups)) {
+		struct group_rq *min = NULL;
+		struct list_elem *e;
+
+		for (e = list_begin (&runqueue.groups); e != list_end (&runqueue.groups);
+				e = list_next (e)) {
+			struct group_rq *grq = list_entry (e, struct group_rq, elem);
+			if (min == NULL || grq->group->vruntime < min->group->vruntime)
+				min = grq;
+		}
+		if (min->group->vruntime > runqueue.min_vruntime)
+			runqueue.min_vruntime = min->group->vruntime;
+		t = list_entry (list_front (&min->queues[bsrq (min->bitmap)]),
+				struct thread, elem);
+		ready_queue_remove (t);
+	}
+	return t;
+}
+
+/* Returns the highest priority among ready threads of the running
+   thread's group, or PRI_MIN - 1 if none is.  Other groups take
+   their turn by vruntime, not priority.  Interrupts must be
+   off. */
+static int
+ready_queue_max_priority (void) {
+	uint64_t bitmap = thread_current ()->group->rq.bitmap;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	return bitmap != 0 ? (int) bsrq (bitmap) : PRI_MIN - 1;
+}
+
+/* Returns the number of ready threads. */
+static int
+ready_queue_cnt (void) {
+	return runqueue.cnt;
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
@@ -475,10 +1219,9 @@ init_thread (struct thread *t, const char *name, int priority) {
    idle_thread. */
 static struct thread *
 next_thread_to_run (void) {
-	if (list_empty (&ready_list))
-		return idle_thread;
-	else
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+	struct thread *t = ready_queue_pop ();
+
+	return t != NULL ? t : runqueue.idle;
 }
 
 /* Use iretq to launch the thread */
@@ -586,10 +1329,10 @@ static void
 do_schedule(int status) {
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (thread_current()->status == THREAD_RUNNING);
-	while (!list_empty (&destruction_req)) {
-		struct thread *victim =
-			list_entry (list_pop_front (&destruction_req), struct thread, elem);
-		palloc_free_page(victim);
+	while (!list_empty (&runqueue.destruction_req)) {
+		struct thread *victim = list_entry (
+				list_pop_front (&runqueue.destruction_req), struct thread, elem);
+		palloc_free_page (victim);
 	}
 	thread_current ()->status = status;
 	schedule ();
@@ -599,6 +1342,7 @@ static void
 schedule (void) {
 	struct thread *curr = running_thread ();
 	struct thread *next = next_thread_to_run ();
+	uint64_t now = rdtsc ();
 
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (curr->status != THREAD_RUNNING);
@@ -606,8 +1350,14 @@ schedule (void) {
 	/* Mark us as running. */
 	next->status = THREAD_RUNNING;
 
+	/* Charge CURR for its run and start NEXT's. */
+	account (curr, false, now);
+	next->acct_tsc = now;
+	trace_event (TRACE_SCHEDULE, next->tid,
+			(uint32_t) curr->tid | (uint64_t) curr->status << 32);
+
 	/* Start new time slice. */
-	thread_ticks = 0;
+	runqueue.thread_ticks = 0;
 
 #ifdef USERPROG
 	/* Activate the new address space. */
@@ -624,7 +1374,7 @@ schedule (void) {
 		   schedule(). */
 		if (curr && curr->status == THREAD_DYING && curr != initial_thread) {
 			ASSERT (curr != next);
-			list_push_back (&destruction_req, &curr->elem);
+			list_push_back (&runqueue.destruction_req, &curr->elem);
 		}
 
 		/* Before switching the thread, we first save the information
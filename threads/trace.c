@@ -0,0 +1,104 @@
+#include "threads/trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Scheduler event trace ring.
+
+   Records are written with interrupts off, so a record is never
+   interleaved with another one, and no lock is needed while only
+   one CPU runs the kernel.  When the ring is full, the oldest
+   records are overwritten.  The dump format still carries a CPU
+   number, always 0, so that utils/trace-latency need not change
+   if CPUs ever get rings of their own. */
+
+/* Pages per ring. */
+#define TRACE_RING_PAGES 4
+
+/* One traced event. */
+struct trace_rec {
+	uint64_t tsc;               /* Time stamp counter. */
+	uint64_t arg;               /* Event-specific argument. */
+	int32_t tid;                /* Thread concerned. */
+	uint32_t type;              /* enum trace_type. */
+};
+
+#define TRACE_RING_SIZE (TRACE_RING_PAGES * PGSIZE / sizeof (struct trace_rec))
+
+/* A trace ring. */
+struct trace_ring {
+	struct trace_rec *recs;     /* TRACE_RING_SIZE records. */
+	uint64_t head;              /* Total records ever written. */
+};
+
+/* True once the rings are allocated and events are recorded. */
+bool trace_enabled;
+
+static struct trace_ring ring;
+
+static const char *type_names[TRACE_TYPE_CNT] = {
+	[TRACE_SCHEDULE] = "schedule",
+	[TRACE_WAKEUP] = "wakeup",
+	[TRACE_BLOCK] = "block",
+	[TRACE_SEMA_DOWN] = "sema_down",
+	[TRACE_SEMA_UP] = "sema_up",
+	[TRACE_LOCK_ACQUIRE] = "lock_acquire",
+};
+
+/* Allocates the trace ring and starts recording events.  Must be
+   called after the page allocator is up. */
+void
+trace_init (void) {
+	ring.recs = palloc_get_multiple (0, TRACE_RING_PAGES);
+	if (ring.recs == NULL) {
+		printf ("trace: out of memory, tracing disabled\n");
+		return;
+	}
+	trace_enabled = true;
+}
+
+/* Appends an event of type TYPE for thread TID with argument ARG
+   to the ring. */
+void
+trace_record (enum trace_type type, int tid, uint64_t arg) {
+	enum intr_level old_level;
+	struct trace_rec *rec;
+
+	ASSERT (type < TRACE_TYPE_CNT);
+
+	old_level = intr_disable ();
+	rec = &ring.recs[ring.head++ % TRACE_RING_SIZE];
+	rec->tsc = rdtsc ();
+	rec->arg = arg;
+	rec->tid = tid;
+	rec->type = type;
+	intr_set_level (old_level);
+}
+
+/* Prints the contents of the ring, oldest record first, for
+   utils/trace-latency.  The first line gives the measured TSC
+   frequency so that timestamps can be converted to time. */
+void
+trace_dump (char **argv UNUSED) {
+	uint64_t head = ring.head;
+	uint64_t i = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+
+	if (!trace_enabled) {
+		printf ("trace: tracing is disabled (use -trace)\n");
+		return;
+	}
+
+	printf ("trace-hz %"PRIu64"\n", timer_tsc_hz ());
+	if (i > 0)
+		printf ("trace-lost 0 %"PRIu64"\n", i);
+	for (; i < head; i++) {
+		struct trace_rec *rec = &ring.recs[i % TRACE_RING_SIZE];
+		printf ("trace 0 %"PRIu64" %d %s %"PRIu64"\n",
+				rec->tsc, rec->tid, type_names[rec->type], rec->arg);
+	}
+}
@@ -0,0 +1,137 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <futex.h>
+#include <list.h>
+#include <stdbool.h>
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Fast user-space mutexes.
+
+   A user program synchronizes through an int in its own memory
+   and only enters the kernel to sleep when that int says the
+   lock or condition is contended (FUTEX_WAIT), or to wake the
+   sleepers (FUTEX_WAKE).
+
+   Sleepers are kept in a fixed hash table of wait queues, keyed
+   on the kernel virtual address of the futex word, which stands
+   for its physical frame and offset.  Each bucket has its own
+   lock, which FUTEX_WAIT holds across the check of the futex
+   word and the enqueue, so a wake-up between the two cannot be
+   lost. */
+
+/* Number of hash buckets.  Must be a power of 2. */
+#define FUTEX_BUCKETS 64
+
+/* A hash bucket: the threads waiting on futexes that hash here. */
+struct futex_bucket {
+	struct lock lock;           /* Guards WAITERS. */
+	struct list waiters;        /* List of struct futex_waiter. */
+};
+
+/* A thread waiting in FUTEX_WAIT. */
+struct futex_waiter {
+	struct list_elem elem;      /* Element in bucket's WAITERS. */
+	void *key;                  /* Kernel address of the futex word. */
+	struct semaphore sema;      /* Upped to wake the waiter. */
+};
+
+static struct futex_bucket buckets[FUTEX_BUCKETS];
+
+/* Initializes the futex wait queues. */
+void
+futex_init (void) {
+	int i;
+
+	for (i = 0; i < FUTEX_BUCKETS; i++) {
+		lock_init (&buckets[i].lock);
+		list_init (&buckets[i].waiters);
+	}
+}
+
+/* Returns the bucket for futex word KEY. */
+static struct futex_bucket *
+key_to_bucket (void *key) {
+	uint64_t k = (uint64_t) key >> 2;
+
+	return &buckets[(k ^ (k >> 10)) & (FUTEX_BUCKETS - 1)];
+}
+
+/* Translates futex address UADDR in the running process to the
+   kernel address of the futex word, or returns a null pointer if
+   UADDR is misaligned or unmapped. */
+static void *
+futex_key (int *uaddr) {
+	uint8_t *kpage;
+
+	if ((uint64_t) uaddr % sizeof *uaddr != 0 || !is_user_vaddr (uaddr))
+		return NULL;
+	kpage = pml4_get_page (thread_current ()->pml4, pg_round_down (uaddr));
+	return kpage != NULL ? kpage + pg_ofs (uaddr) : NULL;
+}
+
+/* Sleeps until woken by FUTEX_WAKE on KEY, unless *KEY != VAL.
+   Returns 0 after being woken, -1 if the value differed. */
+static int
+futex_wait (void *key, int val) {
+	struct futex_bucket *b = key_to_bucket (key);
+	struct futex_waiter w;
+
+	lock_acquire (&b->lock);
+	if (*(volatile int *) key != val) {
+		lock_release (&b->lock);
+		return -1;
+	}
+	w.key = key;
+	sema_init (&w.sema, 0);
+	list_push_back (&b->waiters, &w.elem);
+	lock_release (&b->lock);
+
+	sema_down (&w.sema);
+	return 0;
+}
+
+/* Wakes up to CNT threads waiting on KEY, oldest first.
+   Returns the number woken. */
+static int
+futex_wake (void *key, int cnt) {
+	struct futex_bucket *b = key_to_bucket (key);
+	struct list_elem *e;
+	int woken = 0;
+
+	lock_acquire (&b->lock);
+	for (e = list_begin (&b->waiters);
+			e != list_end (&b->waiters) && woken < cnt; ) {
+		struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+		if (w->key == key) {
+			e = list_remove (e);
+			sema_up (&w->sema);
+			woken++;
+		} else
+			e = list_next (e);
+	}
+	lock_release (&b->lock);
+	return woken;
+}
+
+/* futex() system call: performs operation OP on the futex word at
+   user address UADDR with argument VAL.  Returns -1 on a bad
+   address or operation, and otherwise as futex_wait() or
+   futex_wake(). */
+int
+futex (int *uaddr, int op, int val) {
+	void *key = futex_key (uaddr);
+
+	if (key == NULL)
+		return -1;
+	switch (op) {
+		case FUTEX_WAIT:
+			return futex_wait (key, val);
+		case FUTEX_WAKE:
+			return futex_wake (key, val);
+		default:
+			return -1;
+	}
+}
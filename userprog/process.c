@@ -57,9 +57,15 @@ process_create_initd (const char *file_name) {
 	return tid;
 }
 
-/* A thread function that launches first user process. */
+/* A thread function that launches first user process.  The
+   process leads a scheduling group of its own, which the
+   processes it forks inherit, so that they share one CPU budget
+   however many of them there are.  A process may start a group
+   of its own with the group_new() system call. */
 static void
 initd (void *f_name) {
+	if (!thread_group_new (GROUP_WEIGHT_DEFAULT))
+		PANIC ("Fail to create initd's scheduling group\n");
 #ifdef VM
 	supplemental_page_table_init (&thread_current ()->spt);
 #endif
@@ -1,15 +1,23 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <rusage.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/loader.h"
+#include "threads/mmu.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
 #include "threads/flags.h"
 #include "intrinsic.h"
 
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
+static int sys_getrusage (int who, struct rusage *usage);
+static bool sys_group_new (unsigned weight);
 
 /* System call.
  *
@@ -35,12 +43,91 @@ syscall_init (void) {
 	 * mode stack. Therefore, we masked the FLAG_FL. */
 	write_msr(MSR_SYSCALL_MASK,
 			FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
+
+	futex_init ();
 }
 
 /* The main system call interface */
 void
-syscall_handler (struct intr_frame *f UNUSED) {
-	// TODO: Your implementation goes here.
-	printf ("system call!\n");
-	thread_exit ();
+syscall_handler (struct intr_frame *f) {
+	/* Everything since the last accounting point ran in user
+	   mode; the rest of this call is charged to the kernel. */
+	thread_account (true);
+
+	switch (f->R.rax) {
+		case SYS_GETRUSAGE:
+			f->R.rax = sys_getrusage (f->R.rdi, (struct rusage *) f->R.rsi);
+			break;
+		case SYS_FUTEX:
+			f->R.rax = futex ((int *) f->R.rdi, f->R.rsi, f->R.rdx);
+			break;
+		case SYS_GROUP_NEW:
+			f->R.rax = sys_group_new (f->R.rdi);
+			break;
+		default:
+			// TODO: Your implementation goes here.
+			printf ("system call!\n");
+			thread_exit ();
+	}
+
+	thread_account (false);
+}
+
+/* Returns true if the SIZE bytes at user address UADDR are
+   mapped writable in the running process. */
+static bool
+user_writable (void *uaddr, size_t size) {
+	uint8_t *start = uaddr;
+	uint8_t *end = start + size;
+	uint8_t *p;
+
+	if (start == NULL || end < start || !is_user_vaddr (end - 1))
+		return false;
+	for (p = pg_round_down (start); p < end; p += PGSIZE) {
+		uint64_t *pte = pml4e_walk (thread_current ()->pml4, (uint64_t) p, 0);
+		if (pte == NULL || !(*pte & PTE_P) || !is_writable (pte))
+			return false;
+	}
+	return true;
+}
+
+/* Converts CYCLES of the time stamp counter, running at HZ, to
+   microseconds. */
+static uint64_t
+cycles_to_us (uint64_t cycles, uint64_t hz) {
+	return hz >= 1000000 ? cycles / (hz / 1000000) : 0;
+}
+
+/* getrusage(): stores the CPU time used by the calling process
+   (WHO == RUSAGE_SELF) or thread (WHO == RUSAGE_THREAD) into
+   *USAGE.  Returns 0 on success, -1 on a bad argument. */
+static int
+sys_getrusage (int who, struct rusage *usage) {
+	struct thread *t = thread_current ();
+	uint64_t hz = timer_tsc_hz ();
+	struct rusage ru;
+
+	if ((who != RUSAGE_SELF && who != RUSAGE_THREAD)
+			|| !user_writable (usage, sizeof *usage))
+		return -1;
+
+	/* Bring the kernel time of this call up to date. */
+	thread_account (false);
+	ru.ucycles = t->user_cycles;
+	ru.scycles = t->kernel_cycles;
+	ru.utime_us = cycles_to_us (ru.ucycles, hz);
+	ru.stime_us = cycles_to_us (ru.scycles, hz);
+	memcpy (usage, &ru, sizeof ru);
+	return 0;
+}
+
+/* group_new(): moves the calling process into a new scheduling
+   group of WEIGHT, which the processes it forks from then on
+   share.  Returns false if WEIGHT is out of range or memory is
+   exhausted. */
+static bool
+sys_group_new (unsigned weight) {
+	if (weight < GROUP_WEIGHT_MIN || weight > GROUP_WEIGHT_MAX)
+		return false;
+	return thread_group_new (weight);
 }